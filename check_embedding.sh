@@ -0,0 +1,53 @@
+#!/bin/sh
+# Build embedding_example.cpp, which only sees simulator.h, against simulator.cpp built with and without
+# -DSCHED_PROFILE, each with the example built with and without it, and check that:
+#   simulator.h has no conditional compilation that could change the layout of its types
+#   all four builds give the same output
+#   asking for a profile fails without the profiler and works with it
+# Run from the top of the repository: sh check_embedding.sh
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+if grep -v '^#ifndef SIMULATOR_H$' simulator.h | grep -q '^[[:space:]]*#[[:space:]]*if'; then
+    echo "simulator.h has conditional compilation, the layout of the public types may depend on the build"
+    exit 1
+fi
+
+# the example gets a directory with nothing but the public header
+mkdir "$dir/include"
+cp simulator.h "$dir/include/"
+for lib in plain profile; do
+    flags=""
+    if [ $lib = profile ]; then
+        flags="-DSCHED_PROFILE"
+    fi
+    g++ -O2 -pthread $flags -c simulator.cpp -o "$dir/simulator-$lib.o"
+    g++ -O2 -pthread $flags -I"$dir/include" -c embedding_example.cpp -o "$dir/example-$lib.o"
+done
+
+for lib in plain profile; do
+    for app in plain profile; do
+        build="library $lib, example $app"
+        g++ -pthread "$dir/example-$app.o" "$dir/simulator-$lib.o" -o "$dir/example"
+        if ! "$dir/example" "$dir/log.txt" > "$dir/out.txt"; then
+            echo "$build: the run failed"
+            exit 1
+        fi
+        cat "$dir/log.txt" >> "$dir/out.txt"
+        if [ -f "$dir/expected.txt" ] && ! cmp -s "$dir/out.txt" "$dir/expected.txt"; then
+            echo "$build: the output differs from the first build"
+            exit 1
+        fi
+        cp "$dir/out.txt" "$dir/expected.txt"
+        if [ $lib = plain ] && "$dir/example" "$dir/log.txt" --profile > /dev/null 2>&1; then
+            echo "$build: a profile was asked for without the profiler and the run did not fail"
+            exit 1
+        fi
+        if [ $lib = profile ] && ! "$dir/example" "$dir/log.txt" --profile > /dev/null; then
+            echo "$build: the profiled run failed"
+            exit 1
+        fi
+        echo "$build: ok"
+    done
+done
@@ -0,0 +1,30 @@
+// The example of the README's "Embedding the simulator": drives a run through simulator_t, including
+// nothing of the simulator but simulator.h. check_embedding.sh builds it against the library with and
+// without -DSCHED_PROFILE
+#include <cstring>
+#include <iostream>
+#include "simulator.h"
+
+// embedding_example [output_path] [--profile]
+int main(int argc, char *argv[])
+{
+    sched_params_t params;
+    params.cpus = 2;
+    params.profile = argc > 2 && strcmp(argv[2], "--profile") == 0;
+    simulator_t sim;
+    if (!sim.open("RR", params, argc > 1 ? argv[1] : NULL, OUTPUT_TEXT))
+    {
+        return 1;
+    }
+    sim.add_process(0, 0, {"C 3", "D disk2 4", "C 1"});
+    sim.run_until(10); // simulates ticks 0 to 9
+    sim.add_process(1, 12, {"L mtx", "C 2", "U mtx"});
+    while (sim.step()) // one tick
+    {
+        std::cout << sim.tick() << " " << sim.status(sim.find_process(1)) << " " << sim.load(0) << std::endl;
+    }
+    run_summary_t summary = sim.finish(); // writes the metrics report, closes the output
+    std::cout << summary.completed << " processes, makespan " << summary.makespan << ", median turnaround "
+              << summary.turnaround.percentile(0.5) << std::endl;
+    return summary.failed ? 1 : 0;
+}
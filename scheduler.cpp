@@ -1,664 +1,1462 @@
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include <sstream>
-#include <string>
-#include <cstring>
-using namespace std;
-
-#define MAX_LOOP 1000
-#define K 5
-
-// myMutex structure
-struct Mutex
+#include <array>
+#include <mutex>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "simulator_internal.h"
+
+// Decode a binary output log back into the text format
+int decode_log(const char *binary_path, const char *output_path)
 {
-    bool status_lock; //true-lock   false-unlock
-    Mutex() : status_lock(false) {}
-    Mutex(bool status_)
+    ifstream file(binary_path, ios::binary);
+    vector<unsigned char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (!file.is_open() || data.size() < 4 || memcmp(data.data(), BINARY_LOG_MAGIC, 4) != 0)
     {
-        this->status_lock = status_;
+        cout << binary_path << " is not a binary output log" << endl;
+        return 1;
     }
-    void myMutex_lock()
+    output_writer_t output;
+    if (!output.open(output_path, OUTPUT_TEXT))
     {
-        if (status_lock == false)
-        {
-            status_lock = true;
-        }
+        cout << "Cannot open " << output_path << endl;
+        return 1;
     }
-    void myMutex_unlock()
+    process_t p;
+    vector<int> working;
+    working_log_t logs[2] = {working_log_t(1, false, 0, false), working_log_t(1, true, 0, false)}; // without and with CPUs
+    size_t pos = 4;
+    while (pos < data.size())
     {
-        if (status_lock == true)
+        long long process_id, length, delta;
+        if (!get_varint(data, pos, process_id) || !get_varint(data, pos, length))
+        {
+            cout << binary_path << ": truncated record at byte " << pos << endl;
+            return 1;
+        }
+        bool with_cpus = length < 0; // the CPU of every working interval follows the ticks
+        length = with_cpus ? -length : length;
+        if (length % 2 != 0)
         {
-            status_lock = false;
+            cout << binary_path << ": odd working sequence length before byte " << pos << endl;
+            return 1;
         }
+        p.process_id = process_id;
+        working.clear();
+        long long tick = 0;
+        for (long long i = 0; i < length; i++)
+        {
+            if (!get_varint(data, pos, delta))
+            {
+                cout << binary_path << ": truncated record at byte " << pos << endl;
+                return 1;
+            }
+            tick += delta;
+            working.push_back(tick);
+        }
+        working_log_t &log = logs[with_cpus];
+        for (long long i = 0; i < length / 2; i++)
+        {
+            long long cpu = 0;
+            if (with_cpus && !get_varint(data, pos, cpu))
+            {
+                cout << binary_path << ": truncated record at byte " << pos << endl;
+                return 1;
+            }
+            log.append(0, working[2 * i], working[2 * i + 1], cpu);
+        }
+        output.write_process(p, log, 0);
+        log.release(0);
     }
-} myMutex;
+    return output.close() ? 0 : 1;
+}
 
-// Service structure
-struct service_t
+// Decode an event trace into CSV lines "tick,process,event,resource". The events of one tick follow the
+// steps of the tick: arrivals, I/O completions, mutex hand-overs, work stealing, dispatches, then what
+// ends a working interval; the events of one step are in CPU order
+int decode_trace(const char *trace_path, const char *output_path)
 {
-    string type; // C(CPU), K(keyboard input), D(diskI/O), L(myMutex lock) and U(myMutexunlock)
-    int time_cost;
-    service_t() : type(""), time_cost(-1) {}
-    service_t(string type, string desc) : type(type)
+    ifstream file(trace_path, ios::binary);
+    vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    size_t pos = 4;
+    auto get_int = [&data, &pos](int &value)
     {
-        if (type == "L")
+        if (pos + sizeof(value) > data.size())
         {
-            this->time_cost = 0;
+            return false;
         }
-        else if (type == "U")
+        memcpy(&value, data.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+    if (!file.is_open() || data.size() < 4 || memcmp(data.data(), TRACE_MAGIC, 4) != 0)
+    {
+        cout << trace_path << " is not an event trace" << endl;
+        return 1;
+    }
+    vector<string> names[2]; // devices, mutexes
+    for (int t = 0; t < 2; t++)
+    {
+        size_t names_size = 0;
+        int n;
+        if (!get_int(n) || memchr(data.data() + pos, 0, data.size() - pos) == NULL)
         {
-            this->time_cost = 0;
+            cout << trace_path << ": truncated header" << endl;
+            return 1;
         }
-        else
+        for (int i = 0; i < n && memchr(data.data() + pos, 0, data.size() - pos) != NULL; i++)
         {
-            this->time_cost = stoi(desc);
+            names[t].push_back(string(data.data() + pos));
+            pos += names[t].back().size() + 1;
+            names_size += names[t].back().size() + 1;
         }
+        pos += (4 - names_size % 4) % 4;
     }
-};
-
-// Process structure
-struct process_t
-{
-    int process_id;
-    int arrival_time;
-    vector<service_t> service_seq;
-    service_t cur_service;
-    int cur_service_idx;
-    int cur_service_tick; // num of ticks that has been spent on current service
-    vector<int> working;  // working sequence on CPU, for loging output
-    int priority = 0;     // which priority queue located in ONLY FOR FEEDBACK
-
-    // Call when current service completed
-    // if there are no service left, return true. Otherwise, return false
-    bool proceed_to_next_service()
-    {
-        this->cur_service_idx++;
-        this->cur_service_tick = 0;
-        if (this->cur_service_idx >= this->service_seq.size())
-        { // all services are done, process should end
-            return true;
+    vector<pair<trace_record_t, int> > events; // with the CPU
+    while (pos < data.size())
+    {
+        int n, cpu;
+        if (!get_int(n) || !get_int(cpu) || n < 0 || pos + (size_t)n * 13 > data.size())
+        {
+            cout << trace_path << ": truncated block at byte " << pos << endl;
+            return 1;
         }
-        else
-        { // still requests services
-            this->cur_service = this->service_seq[this->cur_service_idx];
-            return false;
+        const char *columns = data.data() + pos;
+        for (int i = 0; i < n; i++)
+        {
+            trace_record_t event;
+            memcpy(&event.tick, columns + 4 * i, 4);
+            memcpy(&event.process_id, columns + 4 * (n + i), 4);
+            memcpy(&event.resource, columns + 4 * (2 * n + i), 4);
+            event.event = columns[12 * n + i];
+            if (event.event > TRACE_COMPLETE)
+            {
+                cout << trace_path << ": unknown event at byte " << pos + 12 * n + i << endl;
+                return 1;
+            }
+            events.push_back(make_pair(event, cpu));
         }
-    };
-
-    // Log the working ticks on CPU (from `start_tick` to `end_tick`)
-    void log_working(int start_tick, int end_tick)
+        pos += 13 * (size_t)n + (4 - n % 4) % 4;
+    }
+    static const int steps[] = {0, 4, 5, 5, 5, 5, 1, 2, 5, 5, 3, 5}; // indexed by trace_event_t
+    stable_sort(events.begin(), events.end(), [](const pair<trace_record_t, int> &a, const pair<trace_record_t, int> &b)
+                {
+                    if (a.first.tick != b.first.tick)
+                    {
+                        return a.first.tick < b.first.tick;
+                    }
+                    if (steps[a.first.event] != steps[b.first.event])
+                    {
+                        return steps[a.first.event] < steps[b.first.event];
+                    }
+                    return a.second < b.second;
+                });
+    output_writer_t output;
+    if (!output.open(output_path, OUTPUT_TEXT))
     {
-        this->working.push_back(start_tick);
-        this->working.push_back(end_tick);
-    };
-};
+        cout << "Cannot open " << output_path << endl;
+        return 1;
+    }
+    const char *event_names[] = {"arrival", "dispatch", "preempt", "demote", "block", "block", "unblock", "unblock", "lock", "unlock", "migrate", "complete"};
+    output.put_text("tick,process,event,resource\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const trace_record_t &event = events[i].first;
+        int kind = event.event;
+        int table = kind == TRACE_BLOCK_DEVICE || kind == TRACE_UNBLOCK_DEVICE ? 0 : kind == TRACE_BLOCK_MUTEX || kind == TRACE_UNBLOCK_MUTEX || kind == TRACE_LOCK || kind == TRACE_UNLOCK ? 1 : -1;
+        string resource;
+        if (table >= 0)
+        {
+            resource = event.resource >= 0 && event.resource < (int)names[table].size() ? names[table][event.resource] : to_string(event.resource);
+        }
+        else
+        {
+            resource = (kind == TRACE_DEMOTE ? "RQ" : "cpu") + to_string(event.resource);
+        }
+        output.put_text(to_string(event.tick) + "," + to_string(event.process_id) + "," + event_names[kind] + "," + resource + "\n");
+    }
+    return output.close() ? 0 : 1;
+}
 
-// write output log
-int write_file(vector<process_t> processes, const char *file_path)
+// Compare the load throughput of read_processes() and load_processes() on one process file
+int bench_load(const char *file_path, int repeat)
 {
-    ofstream outputfile;
-    outputfile.open(file_path);
-    for (vector<process_t>::iterator p_iter = processes.begin(); p_iter != processes.end(); p_iter++)
+    struct stat file_stat;
+    if (stat(file_path, &file_stat) != 0)
+    {
+        cout << "Cannot open " << file_path << endl;
+        return 1;
+    }
+    double megabytes = file_stat.st_size / 1e6 * repeat;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
     {
-        outputfile << "process " << p_iter->process_id << endl;
-        for (vector<int>::iterator w_iter = p_iter->working.begin(); w_iter != p_iter->working.end(); w_iter++)
+        vector<service_t> services;
+        resource_table_t resources;
+        vector<process_t> processes = read_processes(file_path, services, resources);
+    }
+    chrono::duration<double> stream_time = chrono::steady_clock::now() - start;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        vector<service_t> services;
+        vector<process_t> processes;
+        resource_table_t resources;
+        if (!load_processes(file_path, processes, services, resources))
         {
-            outputfile << *w_iter << " ";
+            return 1;
         }
-        outputfile << endl;
     }
-    outputfile.close();
+    chrono::duration<double> mmap_time = chrono::steady_clock::now() - start;
+    cout << "read_processes: " << megabytes / stream_time.count() << " MB/s" << endl;
+    cout << "load_processes: " << megabytes / mmap_time.count() << " MB/s" << endl;
     return 0;
 }
 
-// Split a string according to a delimiter
-void split(const string &s, vector<string> &tokens, const string &delim = " ")
+// Time `repeat` runs of every scheduling policy over one workload, output discarded
+int bench_policy(const char *file_path, int repeat)
 {
-    string::size_type last_pos = s.find_first_not_of(delim, 0);
-    string::size_type pos = s.find_first_of(delim, last_pos);
-    while (string::npos != pos || string::npos != last_pos)
+    workload_t workload;
+    if (!load_processes(file_path, workload.processes, workload.services, workload.resources))
     {
-        tokens.push_back(s.substr(last_pos, pos - last_pos));
-        last_pos = s.find_first_not_of(delim, pos);
-        pos = s.find_first_of(delim, last_pos);
+        return 1;
+    }
+    const char *algorithms[] = {"FCFS", "RR", "FB", "SPN", "SRT", "HRRN", "CFS"};
+    sched_params_t params;
+    for (int a = 0; a < 7; a++)
+    {
+        long long ticks = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int r = 0; r < repeat; r++)
+        {
+            output_writer_t output;
+            output.open(NULL, OUTPUT_DISCARD);
+            ticks += run_algorithm(algorithms[a], workload, params, output).makespan;
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cout << algorithms[a] << ": " << elapsed.count() / repeat * 1e3 << " ms/run, "
+             << ticks / elapsed.count() << " simulated ticks/s" << endl;
     }
+    return 0;
 }
 
-vector<process_t> read_processes(const char *file_path)
+// generate [synthetic:]spec output_path: dump a synthetic workload as a process file, a run on that file
+// gives the same output as a run on the generator
+int generate(const char *spec_text, const char *output_path)
 {
-    vector<process_t> process_queue;
-    ifstream file(file_path);
-    string str;
-    while (getline(file, str))
-    {
-        process_t new_process;
-        stringstream ss(str);
-        int service_num;
-        char syntax;
-        ss >> syntax >> new_process.process_id >> new_process.arrival_time >> service_num;
-        for (int i = 0; i < service_num; i++)
-        { // read services sequence
-            getline(file, str);
-            str = str.erase(str.find_last_not_of(" \n\r\t") + 1);
-            vector<string> tokens;
-            split(str, tokens, " ");
-            service_t ser(tokens[0], tokens[1]);
-            new_process.service_seq.push_back(ser);
-        }
-        new_process.cur_service_idx = 0;
-        new_process.cur_service_tick = 0;
-        new_process.cur_service = new_process.service_seq[new_process.cur_service_idx];
-        process_queue.push_back(new_process);
-    }
-    return process_queue;
+    if (strncmp(spec_text, SYNTHETIC_PREFIX, strlen(SYNTHETIC_PREFIX)) == 0)
+    {
+        spec_text += strlen(SYNTHETIC_PREFIX);
+    }
+    synthetic_spec_t spec;
+    if (!parse_synthetic_spec(spec_text, spec))
+    {
+        return 1;
+    }
+    if (!write_synthetic_workload(spec, output_path))
+    {
+        cout << "Cannot write " << output_path << endl;
+        return 1;
+    }
+    return 0;
 }
 
-// move the process at the front of q1 to the back of q2 (q1 head -> q2 tail)
-int move_process_from(vector<process_t> &q1, vector<process_t> &q2)
+// Parse one option of a simulation run:
+// --format=text|binary, --metrics-only, --quantum=N, --fb-levels=N, --fb-quanta=Q0:Q1:..., --fb-aging=N,
+// --fb-boost=N, --min-granularity=N, --mem-limit=MB, --cpus=N, --steal=none|busiest|neighbor|half,
+// --sim-threads=N, --seed=N, --checkpoint=PATH, --checkpoint-every=SECONDS, --checkpoint-at=TICK, --trace=PATH
+bool parse_run_option(const string &option, sched_params_t &params, int &format)
 {
-    if (!q1.empty())
+    vector<int> values;
+    if (option == "--format=text")
     {
-        process_t &tmp = q1.front();
-        q2.push_back(tmp);
-        q1.erase(q1.begin());
-        return 1;
+        format = OUTPUT_TEXT;
     }
-    return 0;
+    else if (option == "--format=binary")
+    {
+        format = OUTPUT_BINARY;
+    }
+    else if (option == "--metrics-only")
+    {
+        format = OUTPUT_METRICS;
+    }
+    else if (option.compare(0, 10, "--quantum=") == 0 && parse_int_list(option.substr(10), values, ",") && values.size() == 1)
+    {
+        params.quantum = values[0];
+    }
+    else if (option.compare(0, 12, "--fb-levels=") == 0 && parse_int_list(option.substr(12), values, ",") && values.size() == 1 &&
+             values[0] <= FB_MAX_LEVELS)
+    {
+        params.fb_levels = values[0];
+    }
+    else if (option.compare(0, 12, "--fb-quanta=") == 0 && parse_int_list(option.substr(12), values, ":") && values.size() <= FB_MAX_LEVELS)
+    {
+        params.fb_quanta = values;
+    }
+    else if (option.compare(0, 11, "--fb-aging=") == 0 && parse_int_list(option.substr(11), values, ",") && values.size() == 1)
+    {
+        params.fb_aging = values[0];
+    }
+    else if (option.compare(0, 11, "--fb-boost=") == 0 && parse_int_list(option.substr(11), values, ",") && values.size() == 1)
+    {
+        params.fb_boost = values[0];
+    }
+    else if (option.compare(0, 18, "--min-granularity=") == 0 && parse_int_list(option.substr(18), values, ",") && values.size() == 1)
+    {
+        params.min_granularity = values[0];
+    }
+    else if (option.compare(0, 12, "--mem-limit=") == 0 && parse_int_list(option.substr(12), values, ",") && values.size() == 1)
+    {
+        params.mem_limit = (long long)values[0] << 20;
+    }
+    else if (option.compare(0, 7, "--cpus=") == 0 && parse_int_list(option.substr(7), values, ",") && values.size() == 1)
+    {
+        params.cpus = values[0];
+    }
+    else if (option.compare(0, 8, "--steal=") == 0 && parse_steal_policy(option.substr(8), values))
+    {
+        params.steal = values[0];
+    }
+    else if (option.compare(0, 14, "--sim-threads=") == 0 && parse_int_list(option.substr(14), values, ",") && values.size() == 1)
+    {
+        params.sim_threads = values[0];
+    }
+    else if (option.compare(0, 7, "--seed=") == 0 && option.size() > 7 && option.find_first_not_of("0123456789", 7) == string::npos)
+    {
+        params.seed = strtoull(option.c_str() + 7, NULL, 10);
+    }
+    else if (option.compare(0, 13, "--checkpoint=") == 0 && option.size() > 13)
+    {
+        params.checkpoint_path = option.substr(13);
+    }
+    else if (option.compare(0, 19, "--checkpoint-every=") == 0 && parse_int_list(option.substr(19), values, ",") && values.size() == 1 &&
+             values[0] > 0)
+    {
+        params.checkpoint_every = values[0];
+    }
+    else if (option.compare(0, 16, "--checkpoint-at=") == 0 && parse_int_list(option.substr(16), values, ",") && values.size() == 1)
+    {
+        params.checkpoint_at = values[0];
+    }
+    else if (option.compare(0, 8, "--trace=") == 0 && option.size() > 8)
+    {
+        params.trace_path = option.substr(8);
+    }
+    else if (option.compare(0, 6, "--lod=") == 0 && option.size() > 6)
+    {
+        params.lod_path = option.substr(6);
+    }
+    else if (option == "--profile")
+    {
+#ifdef SCHED_PROFILE
+        params.profile = true;
+#else
+        cerr << "--profile needs a build with -DSCHED_PROFILE" << endl;
+        return false;
+#endif
+    }
+    else
+    {
+        cerr << "Unknown option " << option << endl;
+        return false;
+    }
+    return true;
 }
 
-void manage_next_service_fcfs(process_t &cur_process, int &complete_num, int &dispatched_tick,
-                              int &cur_tick, vector<process_t> &ready_queue, vector<process_t> &processes_done,
-                              vector<process_t> &block_queue_D, vector<process_t> &block_queue_K, vector<process_t> &block_queue_mtx)
+// Work-stealing thread pool: every worker pops tasks from the back of its own deque and, once that is
+// empty, steals from the front of the other workers' deques
+struct task_pool_t
 {
-    bool process_completed = cur_process.proceed_to_next_service();
-    if (process_completed)
-    { // the whole process is completed
-        complete_num++;
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        move_process_from(ready_queue, processes_done); // remove current process from ready queue
-    }
-    else if (cur_process.cur_service.type == "D")
-    { // next service is disk I/O, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        move_process_from(ready_queue, block_queue_D);
-    }
-    else if (cur_process.cur_service.type == "K")
-    { // next service is keyboard input, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        move_process_from(ready_queue, block_queue_K);
-    }
-    else if (cur_process.cur_service.type == "L")
-    { // next service is myMutex lock
-        if (myMutex.status_lock == false)
-        {
-            myMutex.myMutex_lock();
-            manage_next_service_fcfs(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                     processes_done, block_queue_D, block_queue_K, block_queue_mtx); // look for next service
+    typedef function<void(int)> task_t; // called with the index of the worker running it
+
+    struct worker_queue_t
+    {
+        mutex lock;
+        deque<task_t> tasks;
+    };
+
+    vector<unique_ptr<worker_queue_t> > queues;
+    atomic<long> unfinished; // tasks submitted and not completed yet
+
+    task_pool_t(int num_workers) : unfinished(0)
+    {
+        for (int i = 0; i < num_workers; i++)
+        {
+            this->queues.push_back(unique_ptr<worker_queue_t>(new worker_queue_t));
         }
-        else
+    }
+
+    int size() const
+    {
+        return this->queues.size();
+    }
+
+    // Queue a task on `worker`, running tasks may submit more tasks
+    void submit(int worker, const task_t &task)
+    {
+        this->unfinished++;
+        lock_guard<mutex> guard(this->queues[worker]->lock);
+        this->queues[worker]->tasks.push_back(task);
+    }
+
+    bool take(int worker, task_t &task)
+    {
+        for (int i = 0; i < this->size(); i++)
         {
-            cur_process.log_working(dispatched_tick, cur_tick + 1);
-            move_process_from(ready_queue, block_queue_mtx); // block current process
+            worker_queue_t &queue = *this->queues[(worker + i) % this->size()];
+            lock_guard<mutex> guard(queue.lock);
+            if (!queue.tasks.empty())
+            {
+                if (i == 0)
+                { // own queue: newest task first
+                    task = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                else
+                { // steal the oldest task of another worker
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                }
+                return true;
+            }
         }
+        return false;
     }
-    else if (cur_process.cur_service.type == "U")
-    { // next service is myMutex unlock
-        if (myMutex.status_lock == true)
+
+    void work(int worker)
+    {
+        task_t task;
+        while (this->unfinished > 0)
         {
-            myMutex.myMutex_unlock();
-            manage_next_service_fcfs(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                     processes_done, block_queue_D, block_queue_K, block_queue_mtx); // look for next service
+            if (this->take(worker, task))
+            {
+                task(worker);
+                this->unfinished--;
+            }
+            else
+            {
+                this_thread::yield();
+            }
         }
     }
-}
 
-void manage_next_service_rr(process_t &cur_process, int &complete_num, int &dispatched_tick,
-                            int &cur_tick, vector<process_t> &ready_queue, vector<process_t> &processes_done,
-                            vector<process_t> &block_queue_D, vector<process_t> &block_queue_K, vector<process_t> &block_queue_mtx, bool &logged_working)
-{
-    bool process_completed = cur_process.proceed_to_next_service();
-    if (process_completed)
-    { // the whole process is completed
-        complete_num++;
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, processes_done); // remove current process from ready queue
-    }
-    else if (cur_process.cur_service.type == "D")
-    { // next service is disk I/O, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, block_queue_D);
-    }
-    else if (cur_process.cur_service.type == "K")
-    { // next service is keyboard input, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, block_queue_K);
-    }
-    else if (cur_process.cur_service.type == "L")
-    { // next service is myMutex lock
-        if (myMutex.status_lock == false)
-        { //if unlocked
-            myMutex.myMutex_lock();
-            manage_next_service_rr(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                   processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
+    // Run until every task, including the ones submitted by other tasks, is finished
+    void run()
+    {
+        vector<thread> threads;
+        for (int i = 1; i < this->size(); i++)
+        {
+            threads.push_back(thread(&task_pool_t::work, this, i));
         }
-        else
+        this->work(0);
+        for (size_t i = 0; i < threads.size(); i++)
         {
-            cur_process.log_working(dispatched_tick, cur_tick + 1);
-            logged_working = true;
-            move_process_from(ready_queue, block_queue_mtx); //block current process
+            threads[i].join();
         }
     }
-    else if (cur_process.cur_service.type == "U")
-    { //next service is myMutex unlock
-        if (myMutex.status_lock == true)
-        { //if locked
-            myMutex.myMutex_unlock();
-            manage_next_service_rr(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                   processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
+};
+
+// One line of a batch manifest: algorithm input_path output_path [options]
+struct batch_job_t
+{
+    string algorithm;
+    string input_path;
+    string output_path;
+    int format; // output_format_t
+    sched_params_t params;
+};
+
+bool read_manifest(const char *manifest_path, vector<batch_job_t> &jobs)
+{
+    ifstream file(manifest_path);
+    if (!file.is_open())
+    {
+        cout << "Cannot open " << manifest_path << endl;
+        return false;
+    }
+    string str;
+    for (int line = 1; getline(file, str); line++)
+    {
+        vector<string> tokens;
+        split(str, tokens, " \t\r");
+        if (tokens.empty() || tokens[0][0] == '#')
+        { // blank line or comment
+            continue;
+        }
+        batch_job_t job;
+        job.format = OUTPUT_TEXT;
+        if (tokens.size() < 3)
+        {
+            cout << manifest_path << ":" << line << ": expected \"algorithm input_path output_path [options]\"" << endl;
+            return false;
         }
+        for (size_t i = 3; i < tokens.size(); i++)
+        {
+            if (!parse_run_option(tokens[i], job.params, job.format))
+            {
+                cout << manifest_path << ":" << line << ": invalid option" << endl;
+                return false;
+            }
+        }
+        if (!is_algorithm(tokens[0]))
+        {
+            cout << manifest_path << ":" << line << ": algorithm has to be FCFS, RR, FB, SPN, SRT, HRRN or CFS" << endl;
+            return false;
+        }
+        job.algorithm = tokens[0];
+        job.input_path = tokens[1];
+        job.output_path = tokens[2];
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Run all jobs on `num_threads` workers, every input file is parsed once and shared by its jobs
+// Returns the number of failed jobs
+int run_batch(const vector<batch_job_t> &jobs, int num_threads)
+{
+    map<string, vector<int> > jobs_by_input;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        jobs_by_input[jobs[i].input_path].push_back(i);
     }
+    task_pool_t pool(num_threads);
+    atomic<int> failed(0);
+    int next_worker = 0;
+    for (map<string, vector<int> >::iterator it = jobs_by_input.begin(); it != jobs_by_input.end(); it++)
+    {
+        const string &input_path = it->first;
+        const vector<int> &job_ids = it->second;
+        pool.submit(next_worker++ % num_threads, [&pool, &jobs, &failed, &input_path, &job_ids](int worker)
+                    {
+                        shared_ptr<workload_t> workload(new workload_t);
+                        if (!load_workload(input_path.c_str(), *workload))
+                        {
+                            failed += job_ids.size();
+                            return;
+                        }
+                        for (size_t i = 0; i < job_ids.size(); i++)
+                        { // the workload is released once its last job is done
+                            const batch_job_t &job = jobs[job_ids[i]];
+                            pool.submit(worker, [&job, &failed, workload](int)
+                                        {
+                                            output_writer_t output;
+                                            if (!output.open(job.output_path.c_str(), job.format))
+                                            {
+                                                failed++;
+                                                return;
+                                            }
+                                            run_algorithm(job.algorithm, *workload, job.params, output);
+                                            if (!output.close())
+                                            {
+                                                failed++;
+                                            }
+                                        });
+                        }
+                    });
+    }
+    pool.run();
+    return failed;
 }
 
-void manage_next_service_fb(process_t &cur_process, int &complete_num, int &dispatched_tick,
-                            int &cur_tick, vector<process_t> &ready_queue, vector<process_t> &processes_done,
-                            vector<process_t> &block_queue_D, vector<process_t> &block_queue_K, vector<process_t> &block_queue_mtx, bool &logged_working)
+// batch manifest [--threads=N] [--scaling]
+int batch(int argc, char *argv[])
 {
-    bool process_completed = cur_process.proceed_to_next_service();
-    if (process_completed)
-    { // the whole process is completed
-        complete_num++;
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, processes_done); // remove current process from ready queue
-    }
-    else if (cur_process.cur_service.type == "D")
-    { // next service is disk I/O, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, block_queue_D);
-    }
-    else if (cur_process.cur_service.type == "K")
-    { // next service is keyboard input, block current process
-        cur_process.log_working(dispatched_tick, cur_tick + 1);
-        logged_working = true;
-        move_process_from(ready_queue, block_queue_K);
-    }
-    else if (cur_process.cur_service.type == "L")
-    { // next service is myMutex lock
-        if (myMutex.status_lock == false)
-        {
-            myMutex.myMutex_lock();
-            manage_next_service_rr(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                   processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
+    int num_threads = max(1u, thread::hardware_concurrency());
+    bool scaling = false;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--threads=", 10) == 0 && atoi(argv[i] + 10) > 0)
+        {
+            num_threads = atoi(argv[i] + 10);
         }
-        else
+        else if (strcmp(argv[i], "--scaling") == 0)
         {
-            cur_process.log_working(dispatched_tick, cur_tick + 1);
-            logged_working = true;
-            move_process_from(ready_queue, block_queue_mtx);
+            scaling = true;
         }
-    }
-    else if (cur_process.cur_service.type == "U")
-    { // next service is myMutex unlock
-        if (myMutex.status_lock == true)
+        else
         {
-            myMutex.myMutex_unlock();
-            manage_next_service_rr(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                   processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
+            cout << "Unknown option " << argv[i] << endl;
+            return 1;
         }
     }
+    vector<batch_job_t> jobs;
+    if (!read_manifest(argv[2], jobs))
+    {
+        return 1;
+    }
+    vector<int> thread_counts;
+    for (int n = scaling ? 1 : num_threads; n < num_threads; n *= 2)
+    { // with --scaling: 1, 2, 4, ... threads up to N
+        thread_counts.push_back(n);
+    }
+    thread_counts.push_back(num_threads);
+    int failed = 0;
+    for (size_t i = 0; i < thread_counts.size(); i++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        failed = run_batch(jobs, thread_counts[i]);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cout << jobs.size() << " jobs on " << thread_counts[i] << " threads: " << elapsed.count() << " s, "
+             << jobs.size() / elapsed.count() << " jobs/s" << endl;
+    }
+    if (failed > 0)
+    {
+        cout << failed << " jobs failed" << endl;
+        return 1;
+    }
+    return 0;
 }
 
-int fcfs(vector<process_t> processes, const char *output_path)
+// One configuration of a parameter sweep and its result
+struct sweep_point_t
 {
-    vector<process_t> ready_queue;
-    vector<process_t> block_queue_D;
-    vector<process_t> block_queue_K;
-    vector<process_t> processes_done;
-    vector<process_t> block_queue_mtx;
-
-    int complete_num = 0;
-    int dispatched_tick = 0;
-    int cur_process_id = -1, prev_process_id = -1;
+    string algorithm;
+    sched_params_t params;
+    run_summary_t summary;
+};
 
-    // main loop
-    for (int cur_tick = 0; cur_tick < MAX_LOOP; cur_tick++)
+// sweep algorithms input_path results.csv [--quantum=Q,...] [--fb-levels=N,...] [--fb-quanta=Q0:Q1:...,...]
+//       [--min-granularity=G,...] [--cpus=N,...] [--steal=none|busiest|neighbor|half] [--threads=N]
+// Runs every combination of the listed values over one parsed workload. Only the parameters an
+// algorithm uses are combined: FCFS runs once, RR once per quantum, FB once per level configuration and
+// CFS once per granularity, each of them once per number of CPUs
+int sweep(int argc, char *argv[])
+{
+    vector<string> algorithms;
+    split(argv[2], algorithms, ",");
+    vector<int> quanta(1, DEFAULT_QUANTUM), levels(1, FB_LEVELS);
+    vector<string> fb_quanta; // explicit FB level configurations
+    vector<int> granularities(1, DEFAULT_QUANTUM);
+    vector<int> cpus(1, 1);
+    int steal = STEAL_BUSIEST;
+    int num_threads = max(1u, thread::hardware_concurrency());
+    for (int i = 5; i < argc; i++)
     {
-
-        // long term scheduler
-        for (int i = 0; i < processes.size(); i++)
+        string option = argv[i];
+        vector<int> values;
+        if (option.compare(0, 10, "--quantum=") == 0 && parse_int_list(option.substr(10), values, ","))
         {
-            if (processes[i].arrival_time == cur_tick)
-            { // process arrives at current tick
-                ready_queue.push_back(processes[i]);
-            }
+            quanta = values;
         }
-
-        // disk I/O device scheduling
-        if (!block_queue_D.empty())
+        else if (option.compare(0, 12, "--fb-levels=") == 0 && parse_int_list(option.substr(12), values, ",") &&
+                 *max_element(values.begin(), values.end()) <= FB_MAX_LEVELS)
         {
-            process_t &cur_io_process = block_queue_D.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_D, ready_queue);
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            levels = values;
         }
-        // keyboard I/O device scheduling
-        if (!block_queue_K.empty())
+        else if (option.compare(0, 12, "--fb-quanta=") == 0)
         {
-            process_t &cur_io_process = block_queue_K.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_K, ready_queue);
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            split(option.substr(12), fb_quanta, ",");
         }
-        // myMutex scheduling
-        if (!block_queue_mtx.empty())
+        else if (option.compare(0, 18, "--min-granularity=") == 0 && parse_int_list(option.substr(18), values, ","))
         {
-            process_t &cur_mtx_process = block_queue_mtx.front(); // always provide service to the first process in block queue
-            if (cur_mtx_process.cur_service.type == "L")
-            {
-                if (myMutex.status_lock == false)
-                { //lock myMutex if unlocked
-                    myMutex.myMutex_lock();
-                    cur_mtx_process.proceed_to_next_service();
-                    move_process_from(block_queue_mtx, ready_queue);
-                }
-            }
+            granularities = values;
+        }
+        else if (option.compare(0, 7, "--cpus=") == 0 && parse_int_list(option.substr(7), values, ","))
+        {
+            cpus = values;
         }
-        // CPU scheduling
-        if (ready_queue.empty())
-        {                         // no process for scheduling
-            prev_process_id = -1; // reset the previous dispatched process ID to empty
+        else if (option.compare(0, 8, "--steal=") == 0 && parse_steal_policy(option.substr(8), values))
+        {
+            steal = values[0];
+        }
+        else if (option.compare(0, 10, "--threads=") == 0 && parse_int_list(option.substr(10), values, ",") && values.size() == 1)
+        {
+            num_threads = values[0];
         }
         else
         {
-            process_t &cur_process = ready_queue.front(); // always dispatch the first process in ready queue
-            cur_process_id = cur_process.process_id;
-            if (cur_process_id != prev_process_id)
-            { // store the tick when current process is dispatched
-                dispatched_tick = cur_tick;
+            cout << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+    vector<sweep_point_t> points;
+    for (size_t a = 0; a < algorithms.size(); a++)
+    {
+        sweep_point_t point;
+        point.algorithm = algorithms[a];
+        if (!is_algorithm(point.algorithm))
+        {
+            cout << "Wrong scheduling algorithm format, has to be FCFS, RR, FB, SPN, SRT, HRRN or CFS" << endl;
+            return 1;
+        }
+        if (point.algorithm != "RR" && point.algorithm != "FB" && point.algorithm != "CFS")
+        { // no parameters to sweep
+            points.push_back(point);
+        }
+        for (size_t g = 0; g < granularities.size() && point.algorithm == "CFS"; g++)
+        {
+            point.params.min_granularity = granularities[g];
+            points.push_back(point);
+        }
+        for (size_t q = 0; q < quanta.size() && point.algorithm == "RR"; q++)
+        {
+            point.params.quantum = quanta[q];
+            points.push_back(point);
+        }
+        for (size_t f = 0; f < fb_quanta.size() && point.algorithm == "FB"; f++)
+        {
+            point.params.fb_quanta.clear();
+            if (!parse_int_list(fb_quanta[f], point.params.fb_quanta, ":") || point.params.fb_quanta.size() > FB_MAX_LEVELS)
+            {
+                cout << "Invalid FB level configuration " << fb_quanta[f] << endl;
+                return 1;
             }
-            cur_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
-            if (cur_process.cur_service_tick >= cur_process.cur_service.time_cost)
-            { // current service is completed
-                manage_next_service_fcfs(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                         processes_done, block_queue_D, block_queue_K, block_queue_mtx); // look for next service
+            points.push_back(point);
+        }
+        for (size_t q = 0; q < quanta.size() && point.algorithm == "FB" && fb_quanta.empty(); q++)
+        {
+            for (size_t l = 0; l < levels.size(); l++)
+            {
+                point.params.quantum = quanta[q];
+                point.params.fb_levels = levels[l];
+                points.push_back(point);
             }
-            prev_process_id = cur_process_id; // log the previous dispatched process ID
         }
-        if (complete_num == processes.size())
-        { // all process completed
-            break;
+    }
+    vector<sweep_point_t> uniprocessor_points;
+    points.swap(uniprocessor_points);
+    for (size_t i = 0; i < uniprocessor_points.size(); i++)
+    {
+        for (size_t c = 0; c < cpus.size(); c++)
+        {
+            sweep_point_t point = uniprocessor_points[i];
+            point.params.cpus = cpus[c];
+            point.params.steal = steal;
+            points.push_back(point);
         }
     }
-    write_file(processes_done, output_path); // write output
-    return 1;
+    workload_t workload;
+    if (!load_workload(argv[3], workload))
+    {
+        return 1;
+    }
+    task_pool_t pool(num_threads);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        sweep_point_t &point = points[i];
+        pool.submit(i % num_threads, [&point, &workload](int)
+                    {
+                        output_writer_t output;
+                        output.open(NULL, OUTPUT_DISCARD);
+                        point.summary = run_algorithm(point.algorithm, workload, point.params, output);
+                    });
+    }
+    pool.run();
+    ofstream csv(argv[4]);
+    if (!csv.is_open())
+    {
+        cout << "Cannot open " << argv[4] << endl;
+        return 1;
+    }
+    csv.precision(12);
+    csv << "algorithm,quantum,fb_quanta,cpus,completed,makespan,avg_turnaround,avg_waiting,avg_response,cpu_utilisation,throughput,p50_turnaround,p95_turnaround,p99_turnaround\n";
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const sweep_point_t &point = points[i];
+        const run_summary_t &summary = point.summary;
+        csv << point.algorithm << ",";
+        if (point.algorithm == "RR")
+        {
+            csv << point.params.quantum;
+        }
+        else if (point.algorithm == "CFS")
+        {
+            csv << point.params.min_granularity;
+        }
+        csv << ",";
+        for (int l = 0; point.algorithm == "FB" && l < point.params.levels(); l++)
+        {
+            csv << (l > 0 ? ":" : "") << point.params.level_quantum(l);
+        }
+        csv << "," << point.params.cpus << "," << summary.completed << "," << summary.makespan << "," << summary.average(summary.total_turnaround)
+            << "," << summary.average(summary.total_waiting) << "," << summary.average(summary.total_response)
+            << "," << summary.cpu_utilisation() << "," << summary.throughput() << "," << summary.turnaround.percentile(0.5)
+            << "," << summary.turnaround.percentile(0.95) << "," << summary.turnaround.percentile(0.99) << "\n";
+    }
+    return 0;
 }
 
-int rr(vector<process_t> processes, const char *output_path)
-{
-    vector<process_t> ready_queue;
-    vector<process_t> block_queue_D;
-    vector<process_t> block_queue_K;
-    vector<process_t> processes_done;
-    vector<process_t> block_queue_mtx;
+// Two-sided 95% quantiles of Student's t distribution for 1 to 30 degrees of freedom, 1.96 is used beyond
+static const double T_QUANTILES_95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
 
-    int complete_num = 0;
-    int dispatched_tick = 0;
-    int cur_process_id = -1, prev_process_id = -1;
+#define REPLICATION_METRICS 10
 
-    // main loop
-    for (int cur_tick = 0; cur_tick < MAX_LOOP; cur_tick++)
+// Monte Carlo estimate of the metrics of a workload with stochastic service costs: `replications` runs of
+// `algorithm`, each with its own seed, share the workload and are spread over `num_threads` threads. Replication r
+// draws with the r-th number of the seed stream of params.seed, so the report does not depend on the thread count.
+// Writes the mean, standard deviation and 95% confidence interval of every metric to `report_path`
+int replicate(const char *algorithm, const workload_t &workload, const sched_params_t &params, int replications, int num_threads,
+              const char *report_path)
+{
+    const char *names[REPLICATION_METRICS] = {"completed", "makespan", "avg_turnaround", "avg_waiting", "avg_response",
+                                              "cpu_utilisation", "throughput", "p50_turnaround", "p95_turnaround", "p99_turnaround"};
+    vector<sched_params_t> replication_params(replications, params);
+    rng_t seeds(params.seed);
+    for (int r = 0; r < replications; r++)
     {
-
-        // long term scheduler
-        for (int i = 0; i < processes.size(); i++)
+        replication_params[r].seed = seeds.next();
+    }
+    vector<array<double, REPLICATION_METRICS> > values(replications);
+    task_pool_t pool(num_threads);
+    for (int r = 0; r < replications; r++)
+    {
+        pool.submit(r % num_threads, [&, r](int)
+                    {
+                        output_writer_t output;
+                        output.open(NULL, OUTPUT_DISCARD);
+                        run_summary_t summary = run_algorithm(algorithm, workload, replication_params[r], output);
+                        values[r] = {(double)summary.completed, (double)summary.makespan, summary.average(summary.total_turnaround),
+                                     summary.average(summary.total_waiting), summary.average(summary.total_response),
+                                     summary.cpu_utilisation(), summary.throughput(), (double)summary.turnaround.percentile(0.5),
+                                     (double)summary.turnaround.percentile(0.95), (double)summary.turnaround.percentile(0.99)};
+                    });
+    }
+    pool.run();
+    ofstream csv(report_path);
+    if (!csv.is_open())
+    {
+        cout << "Cannot open " << report_path << endl;
+        return 1;
+    }
+    csv.precision(12);
+    csv << "metric,replications,mean,stddev,ci95_low,ci95_high,min,max\n";
+    double t = replications - 1 <= 30 ? T_QUANTILES_95[max(replications - 2, 0)] : 1.96;
+    for (int m = 0; m < REPLICATION_METRICS; m++)
+    {
+        double sum = 0, low = values[0][m], high = values[0][m];
+        for (int r = 0; r < replications; r++)
         {
-            if (processes[i].arrival_time == cur_tick)
-            { // process arrives at current tick
-                ready_queue.push_back(processes[i]);
-            }
+            sum += values[r][m];
+            low = min(low, values[r][m]);
+            high = max(high, values[r][m]);
         }
-
-        // disk I/O device scheduling
-        if (!block_queue_D.empty())
+        double mean = sum / replications, squares = 0;
+        for (int r = 0; r < replications; r++)
         {
-            process_t &cur_io_process = block_queue_D.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_D, ready_queue);
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            squares += (values[r][m] - mean) * (values[r][m] - mean);
         }
-        // keyboard I/O device scheduling
-        if (!block_queue_K.empty())
+        double stddev = replications > 1 ? sqrt(squares / (replications - 1)) : 0;
+        double half_width = t * stddev / sqrt(replications);
+        csv << names[m] << "," << replications << "," << mean << "," << stddev << "," << mean - half_width << "," << mean + half_width
+            << "," << low << "," << high << "\n";
+    }
+    return 0;
+}
+
+// Result of one benchmark phase, sent back by the child process that ran it
+struct bench_result_t
+{
+    bool ok;
+    double seconds;
+    long long ticks;       // simulated ticks, 0 for the phases that do not simulate
+    long long transitions; // dispatches, I/O and mutex waits and completions; queue moves for move_process_from
+};
+
+// Run `phase` in a child process, so that the peak RSS is the phase's own. Returns false if the child failed
+bool run_bench_phase(const function<bench_result_t()> &phase, bench_result_t &result, long long &peak_rss_kb)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+    cout.flush(); // the child must not write what is still buffered
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        bench_result_t r = phase();
+        bool sent = write(fds[1], &r, sizeof(r)) == (ssize_t)sizeof(r);
+        _exit(sent && r.ok ? 0 : 1);
+    }
+    close(fds[1]);
+    bool received = read(fds[0], &result, sizeof(result)) == (ssize_t)sizeof(result);
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid)
+    {
+        return false;
+    }
+    peak_rss_kb = usage.ru_maxrss;
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Time `repeat` round trips of `n` processes between two run queues
+bench_result_t bench_move_process_from(int n, int repeat)
+{
+    ring_queue_t q1(n), q2(n);
+    for (int handle = 0; handle < n; handle++)
+    {
+        q1.push_back(handle);
+    }
+    bench_result_t result = {true, 0, 0, 0};
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        while (move_process_from(q1, q2) != 0)
         {
-            process_t &cur_io_process = block_queue_K.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_K, ready_queue);
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            result.transitions++;
         }
-        // myMutex scheduling
-        if (!block_queue_mtx.empty())
+        while (move_process_from(q2, q1) != 0)
         {
-            process_t &cur_mtx_process = block_queue_mtx.front(); // always provide service to the first process in block queue
-            if (cur_mtx_process.cur_service.type == "L")
-            {
-                if (myMutex.status_lock == false)
-                {
-                    myMutex.myMutex_lock();
-                    cur_mtx_process.proceed_to_next_service();
-                    move_process_from(block_queue_mtx, ready_queue);
-                }
-            }
+            result.transitions++;
         }
-        // CPU scheduling
-        if (ready_queue.empty())
-        {                         // no process for scheduling
-            prev_process_id = -1; // reset the previous dispatched process ID to empty
-        }
-        else
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+#define BENCH_DEVICES 100000 // devices of the wakeup benchmark, each with a process blocked on it at once
+
+// Time FCFS on one CPU over `n` processes that each run a tick, then wait for one of BENCH_DEVICES named
+// devices at least as long as it takes to block them all, then run another tick. Up to 100k processes
+// are blocked at once, only the I/O completions of a tick should cost anything
+bench_result_t bench_device_wakeups(int n)
+{
+    workload_t workload;
+    int devices = min(n, BENCH_DEVICES);
+    for (int i = 0; i < n; i++)
+    {
+        process_t p;
+        p.process_id = i;
+        p.arrival_time = 0;
+        p.service_offset = workload.services.size();
+        p.service_num = 3;
+        p.cur_service_idx = 0;
+        p.cur_service_tick = 0;
+        workload.processes.push_back(p);
+        vector<string> tokens = {"C", "1"};
+        workload.services.push_back(service_t(tokens, workload.resources));
+        tokens = {"D", "dev" + to_string(i % devices), to_string(devices + (i * 7919LL) % devices)};
+        workload.services.push_back(service_t(tokens, workload.resources));
+        tokens = {"C", "1"};
+        workload.services.push_back(service_t(tokens, workload.resources));
+    }
+    bench_result_t result = {true, 0, 0, 0};
+    output_writer_t output;
+    output.open(NULL, OUTPUT_DISCARD);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    run_summary_t summary = run_algorithm("FCFS", workload, sched_params_t(), output);
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.ticks = summary.makespan;
+    result.transitions = summary.completed;
+    for (size_t i = 0; i < summary.queues.size(); i++)
+    {
+        result.transitions += summary.queues[i].second.entries;
+    }
+    return result;
+}
+
+#define BENCH_LONG_EVERY 50    // every 50th process of the starvation benchmark is a long one
+#define BENCH_LONG_TICKS 5000  // CPU ticks of a long process
+
+// Time FB on one CPU with FB_MAX_LEVELS levels of quantum 1 over `n` processes arriving one per tick. Most
+// need a single tick, which keeps RQ0 busy 98% of the time, every BENCH_LONG_EVERY-th one needs
+// BENCH_LONG_TICKS and sinks to the lowest level, where it starves unless aging or boosts lift it
+bench_result_t bench_fb_starvation(int n, int aging, int boost)
+{
+    workload_t workload;
+    for (int i = 0; i < n; i++)
+    {
+        process_t p;
+        p.process_id = i;
+        p.arrival_time = i;
+        p.service_offset = workload.services.size();
+        p.service_num = 1;
+        p.cur_service_idx = 0;
+        p.cur_service_tick = 0;
+        workload.processes.push_back(p);
+        vector<string> tokens = {"C", i % BENCH_LONG_EVERY == 0 ? to_string(BENCH_LONG_TICKS) : "1"};
+        workload.services.push_back(service_t(tokens, workload.resources));
+    }
+    sched_params_t params;
+    params.quantum = 1;
+    params.fb_levels = FB_MAX_LEVELS;
+    params.fb_aging = aging;
+    params.fb_boost = boost;
+    bench_result_t result = {true, 0, 0, 0};
+    output_writer_t output;
+    output.open(NULL, OUTPUT_DISCARD);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    run_summary_t summary = run_algorithm("FB", workload, params, output);
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.ticks = summary.makespan;
+    result.transitions = summary.completed;
+    for (size_t i = 0; i < summary.queues.size(); i++)
+    {
+        result.transitions += summary.queues[i].second.entries;
+    }
+    return result;
+}
+
+// Time CFS on one CPU with a granularity of 1 tick over `n` processes of different weights that all arrive at
+// tick 0 and need 2 ticks: every tick dispatches a process out of a ready set of about `n`
+bench_result_t bench_cfs_dispatch(int n)
+{
+    workload_t workload;
+    for (int i = 0; i < n; i++)
+    {
+        process_t p;
+        p.process_id = i;
+        p.arrival_time = 0;
+        p.service_offset = workload.services.size();
+        p.service_num = 1;
+        p.cur_service_idx = 0;
+        p.cur_service_tick = 0;
+        p.weight = CFS_DEFAULT_WEIGHT / 4 * (1 + i % 8);
+        workload.processes.push_back(p);
+        vector<string> tokens = {"C", "2"};
+        workload.services.push_back(service_t(tokens, workload.resources));
+    }
+    sched_params_t params;
+    params.min_granularity = 1;
+    bench_result_t result = {true, 0, 0, 0};
+    output_writer_t output;
+    output.open(NULL, OUTPUT_DISCARD);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    run_summary_t summary = run_algorithm("CFS", workload, params, output);
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.ticks = summary.makespan;
+    result.transitions = summary.completed;
+    for (size_t i = 0; i < summary.queues.size(); i++)
+    {
+        result.transitions += summary.queues[i].second.entries;
+    }
+    return result;
+}
+
+// Time one run of `algorithm` over the process file, output discarded
+bench_result_t bench_run(const string &algorithm, const char *file_path, const sched_params_t &params)
+{
+    bench_result_t result = {false, 0, 0, 0};
+    workload_t workload;
+    if (!load_processes(file_path, workload.processes, workload.services, workload.resources))
+    {
+        return result;
+    }
+    output_writer_t output;
+    output.open(NULL, OUTPUT_DISCARD);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    run_summary_t summary = run_algorithm(algorithm, workload, params, output);
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.ok = true;
+    result.ticks = summary.makespan;
+    result.transitions = summary.completed;
+    for (size_t i = 0; i < summary.queues.size(); i++)
+    {
+        result.transitions += summary.queues[i].second.entries;
+    }
+    return result;
+}
+
+#define BENCH_TRACED_SUFFIX "_traced" // phase of an algorithm run again with the event trace, written to /dev/null
+#define BENCH_MIN_COMPARED_SECONDS 0.05 // shorter phases are too noisy to flag as regressions
+
+// Wall time of every "processes,mix,phase" row of an earlier bench CSV
+bool read_bench_baseline(const char *file_path, map<string, double> &wall_times)
+{
+    ifstream in(file_path);
+    if (!in.is_open())
+    {
+        cout << "Cannot open " << file_path << endl;
+        return false;
+    }
+    string line;
+    getline(in, line); // header
+    while (getline(in, line))
+    {
+        vector<string> fields;
+        split(line, fields, ",");
+        if (fields.size() >= 4)
         {
-            bool logged_working = false;                  // flag to track if cur_process.log_working() already occured
-            process_t &cur_process = ready_queue.front(); // always dispatch the first process in ready queue
-            cur_process_id = cur_process.process_id;
-            if (cur_process_id != prev_process_id)
-            { // store the tick when current process is dispatched
-                dispatched_tick = cur_tick;
-            }
-            cur_process.cur_service_tick++;   // increment the num of ticks that have been spent on current service
-            prev_process_id = cur_process_id; // log the previous dispatched process ID
-            if (cur_process.cur_service_tick >= cur_process.cur_service.time_cost)
-            { // current service is completed
-                manage_next_service_rr(cur_process, complete_num, dispatched_tick, cur_tick, ready_queue,
-                                       processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
-            }
-            if (cur_tick + 1 - dispatched_tick >= K)
-            { // check Clock interrupts
-                if (logged_working == false)
-                { //check if log_working already occured in manage_next_service_rr(...)
-                    cur_process.log_working(dispatched_tick, cur_tick + 1);
-                    move_process_from(ready_queue, ready_queue); //put process to the tail of ready_queue
-                    prev_process_id = -1;                        // reset the previous dispatched process ID to empty
-                }
-            }
-        }
-        if (complete_num == processes.size())
-        { // all process completed
-            break;
+            wall_times[fields[0] + "," + fields[1] + "," + fields[2]] = atof(fields[3].c_str());
         }
     }
-    write_file(processes_done, output_path); // write output
-    return 1;
+    return true;
 }
 
-int fb(vector<process_t> processes, const char *output_path)
+// bench results.csv [--sizes=N,...] [--mix=CPU:IO:MUTEX,...] [--algorithms=FCFS,RR,FB] [--seed=N]
+//       [--baseline=old.csv] [--tolerance=PERCENT] [--repeat=N]
+// For every size and service mix, generates a synthetic workload and times read_processes(),
+// load_processes(), move_process_from(), device wakeups, FB under starvation with and without aging, CFS
+// dispatches out of a ready set of every size and each algorithm, untraced and traced, every phase in its own
+// child process. With --repeat, all the phases run that many times in turn and the fastest run of each is kept.
+// With a baseline, phases slower than it by more than the tolerance are reported and the exit code is 1
+int bench_suite(int argc, char *argv[])
 {
-    vector<vector<process_t> > ready_queues;
-    vector<process_t> RQ0; //highest priority queue
-    vector<process_t> RQ1; //middle priority queue
-    vector<process_t> RQ2; //lowest priority queue
-    ready_queues.push_back(RQ0);
-    ready_queues.push_back(RQ1);
-    ready_queues.push_back(RQ2);
-    vector<process_t> block_queue_D;
-    vector<process_t> block_queue_K;
-    vector<process_t> processes_done;
-    vector<process_t> block_queue_mtx;
-
-    int complete_num = 0;
-    int dispatched_tick = 0;
-    int cur_process_id = -1, prev_process_id = -1;
-
-    // main loop
-    for (int cur_tick = 0; cur_tick < MAX_LOOP; cur_tick++)
-    {
-
-        // long term scheduler
-        for (int i = 0; i < processes.size(); i++)
-        {
-            if (processes[i].arrival_time == cur_tick)
-            {                                            // process arrives at current tick
-                processes[i].priority = 0;               //set highest priority for new processes
-                ready_queues[0].push_back(processes[i]); // add new process to queue with highest priority
-            }
+    vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    vector<string> mixes = {"70:20:10"};
+    vector<string> algorithms = {"FCFS", "RR", "FB"};
+    unsigned long long seed = 1;
+    const char *baseline_path = NULL;
+    double tolerance = 10;
+    int repeat = 1;
+    for (int i = 3; i < argc; i++)
+    {
+        string option = argv[i];
+        vector<int> values;
+        if (option.compare(0, 8, "--sizes=") == 0 && parse_int_list(option.substr(8), values, ","))
+        {
+            sizes = values;
         }
-
-        // disk I/O device scheduling
-        if (!block_queue_D.empty())
+        else if (option.compare(0, 6, "--mix=") == 0)
         {
-            process_t &cur_io_process = block_queue_D.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_D, ready_queues[cur_io_process.priority]); //re-insert to the tail of same ready queue where it was dispatched earlier
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            mixes.clear();
+            split(option.substr(6), mixes, ",");
         }
-        // keyboard I/O device scheduling
-        if (!block_queue_K.empty())
+        else if (option.compare(0, 13, "--algorithms=") == 0)
         {
-            process_t &cur_io_process = block_queue_K.front(); // always provide service to the first process in block queue
-            if (cur_io_process.cur_service_tick >= cur_io_process.cur_service.time_cost)
-            { // I/O service is completed
-                cur_io_process.proceed_to_next_service();
-                move_process_from(block_queue_K, ready_queues[cur_io_process.priority]); //re-insert to the tail of same ready queue where it was dispatched earlier
-            }
-            cur_io_process.cur_service_tick++; // increment the num of ticks that have been spent on current service
+            algorithms.clear();
+            split(option.substr(13), algorithms, ",");
         }
-        // myMutex scheduling
-        if (!block_queue_mtx.empty())
+        else if (option.compare(0, 7, "--seed=") == 0)
         {
-            process_t &cur_mtx_process = block_queue_mtx.front(); // always provide service to the first process in block queue
-            if (cur_mtx_process.cur_service.type == "L")
-            { // next service is myMutex lock
-                if (myMutex.status_lock == false)
-                {
-                    myMutex.myMutex_lock();
-                    cur_mtx_process.proceed_to_next_service();
-                    move_process_from(block_queue_mtx, ready_queues[cur_mtx_process.priority]); //re-insert to the tail of same ready queue where it was dispatched earlier
-                }
-            }
+            seed = strtoull(option.c_str() + 7, NULL, 10);
         }
-        // CPU scheduling
-        bool isEmptyRQ = true;           // flag to track if there is any process in any of RQs
-        int notEmptyQ_priority_idx = -1; // index of a queue that is not empty, if empty default value = -1
-        for (int i = 0; i < 3; i++)
-        { // loop checks if there is any process in any of RQs
-            if (!ready_queues[i].empty())
-            {
-                notEmptyQ_priority_idx = i;
-                isEmptyRQ = false;
-                break;
-            }
+        else if (option.compare(0, 11, "--baseline=") == 0)
+        {
+            baseline_path = argv[i] + 11;
         }
-        if (isEmptyRQ)
-        {                         // no process for scheduling
-            prev_process_id = -1; // reset the previous dispatched process ID to empty
+        else if (option.compare(0, 12, "--tolerance=") == 0 && parse_int_list(option.substr(12), values, ",") && values.size() == 1)
+        {
+            tolerance = values[0];
+        }
+        else if (option.compare(0, 9, "--repeat=") == 0 && parse_int_list(option.substr(9), values, ",") && values.size() == 1 &&
+                 values[0] >= 1)
+        {
+            repeat = values[0];
         }
         else
         {
-            bool logged_working = false;                                           // flag to track if cur_process.log_working() already occured
-            process_t &cur_process = ready_queues[notEmptyQ_priority_idx].front(); // always dispatch the first process in ready queue
-            cur_process_id = cur_process.process_id;
-            if (cur_process_id != prev_process_id)
-            { // store the tick when current process is dispatched
-                dispatched_tick = cur_tick;
+            cout << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+    vector<synthetic_spec_t> specs(mixes.size());
+    for (size_t m = 0; m < mixes.size(); m++)
+    {
+        if (!parse_mix(mixes[m], specs[m]))
+        {
+            cout << "Wrong service mix " << mixes[m] << ", has to be CPU:IO:MUTEX weights" << endl;
+            return 1;
+        }
+    }
+    for (size_t a = 0; a < algorithms.size(); a++)
+    {
+        if (!is_algorithm(algorithms[a]))
+        {
+            cout << "Unknown algorithm " << algorithms[a] << endl;
+            return 1;
+        }
+    }
+    map<string, double> baseline;
+    if (baseline_path != NULL && !read_bench_baseline(baseline_path, baseline))
+    {
+        return 1;
+    }
+    ofstream csv(argv[2]);
+    if (!csv.is_open())
+    {
+        cout << "Cannot open " << argv[2] << endl;
+        return 1;
+    }
+    csv.precision(9);
+    csv << "processes,mix,phase,wall_s,ticks,ticks_per_s,transitions,transitions_per_s,peak_rss_kb\n";
+    int regressions = 0;
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        for (size_t m = 0; m < specs.size(); m++)
+        {
+            synthetic_spec_t spec = specs[m];
+            spec.processes = sizes[s];
+            spec.seed = seed;
+            char input_path[] = "/tmp/scheduler-bench-XXXXXX";
+            int fd = mkstemp(input_path);
+            if (fd < 0 || close(fd) != 0 || !write_synthetic_workload(spec, input_path))
+            {
+                cout << "Cannot write a workload to " << input_path << endl;
+                return 1;
             }
-            cur_process.cur_service_tick++;   // increment the num of ticks that have been spent on current service
-            prev_process_id = cur_process_id; // log the previous dispatched process ID
-            if (cur_process.cur_service_tick >= cur_process.cur_service.time_cost)
-            { // current service is completed
-                manage_next_service_fb(cur_process, complete_num, dispatched_tick, cur_tick, ready_queues[notEmptyQ_priority_idx],
-                                       processes_done, block_queue_D, block_queue_K, block_queue_mtx, logged_working); // look for next service
+            vector<pair<string, function<bench_result_t()> > > phases;
+            phases.push_back(make_pair("read_processes", [&input_path]()
+                                       {
+                                           bench_result_t result = {true, 0, 0, 0};
+                                           chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                                           vector<service_t> services;
+                                           resource_table_t resources;
+                                           result.ok = !read_processes(input_path, services, resources).empty();
+                                           result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                                           return result;
+                                       }));
+            phases.push_back(make_pair("load_processes", [&input_path]()
+                                       {
+                                           bench_result_t result = {true, 0, 0, 0};
+                                           chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                                           workload_t workload;
+                                           result.ok = load_processes(input_path, workload.processes, workload.services, workload.resources);
+                                           result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                                           return result;
+                                       }));
+            int n = sizes[s];
+            phases.push_back(make_pair("move_process_from", [n]()
+                                       { return bench_move_process_from(n, max(1, 10000000 / n)); }));
+            phases.push_back(make_pair("device_wakeups", [n]()
+                                       { return bench_device_wakeups(n); }));
+            phases.push_back(make_pair("fb_starvation", [n]()
+                                       { return bench_fb_starvation(n, 0, 0); }));
+            phases.push_back(make_pair("fb_starvation_aging", [n]()
+                                       { return bench_fb_starvation(n, 100, 10000); }));
+            phases.push_back(make_pair("cfs_dispatch", [n]()
+                                       { return bench_cfs_dispatch(n); }));
+            for (size_t a = 0; a < algorithms.size(); a++)
+            {
+                string algorithm = algorithms[a];
+                phases.push_back(make_pair(algorithm, [algorithm, &input_path]()
+                                           { return bench_run(algorithm, input_path, sched_params_t()); }));
+                phases.push_back(make_pair(algorithm + BENCH_TRACED_SUFFIX, [algorithm, &input_path]()
+                                           {
+                                               sched_params_t params;
+                                               params.trace_path = "/dev/null";
+                                               return bench_run(algorithm, input_path, params);
+                                           }));
             }
-            if (cur_tick + 1 - dispatched_tick >= K)
-            { // check Clock interrupts
-                if (logged_working == false)
-                { //check if log_working already occured in manage_next_service_fb(...)
-                    cur_process.log_working(dispatched_tick, cur_tick + 1);
-                    if (notEmptyQ_priority_idx != 2)
-                    {                           // if process was not in a queue with lowest priority
-                        cur_process.priority++; //update priority of a process and move to respective queue
-                        move_process_from(ready_queues[notEmptyQ_priority_idx], ready_queues[notEmptyQ_priority_idx + 1]);
+            // the repeats go round all the phases in turn, so that a slow spell of the host does not fall on only
+            // one of the phases that are compared
+            vector<bench_result_t> results(phases.size());
+            vector<long long> peak_rss(phases.size(), 0);
+            for (int r = 0; r < repeat; r++)
+            {
+                for (size_t p = 0; p < phases.size(); p++)
+                {
+                    bench_result_t run;
+                    long long peak_rss_kb = 0;
+                    if (!run_bench_phase(phases[p].second, run, peak_rss_kb))
+                    {
+                        cout << sizes[s] << " " << mixes[m] << " " << phases[p].first << ": failed" << endl;
+                        unlink(input_path);
+                        return 1;
                     }
-                    else
-                    { // if process is already in a queue with lowest priority put it to the tail of that queue
-                        move_process_from(ready_queues[2], ready_queues[2]);
+                    if (r == 0 || run.seconds < results[p].seconds)
+                    {
+                        results[p] = run;
                     }
-                    prev_process_id = -1; // reset the previous dispatched process ID to empty
+                    peak_rss[p] = max(peak_rss[p], peak_rss_kb);
                 }
             }
+            map<string, double> phase_seconds;
+            for (size_t p = 0; p < phases.size(); p++)
+            {
+                const bench_result_t &result = results[p];
+                long long peak_rss_kb = peak_rss[p];
+                double seconds = max(result.seconds, 1e-9);
+                string key = to_string(sizes[s]) + "," + mixes[m] + "," + phases[p].first;
+                csv << key << "," << result.seconds << "," << result.ticks << "," << result.ticks / seconds << ","
+                    << result.transitions << "," << result.transitions / seconds << "," << peak_rss_kb << "\n";
+                cout << sizes[s] << " " << mixes[m] << " " << phases[p].first << ": " << result.seconds << " s";
+                if (result.ticks > 0)
+                {
+                    cout << ", " << result.ticks / seconds << " ticks/s";
+                }
+                if (result.transitions > 0)
+                {
+                    cout << ", " << result.transitions / seconds << " transitions/s";
+                }
+                cout << ", peak RSS " << peak_rss_kb << " KB";
+                phase_seconds[phases[p].first] = result.seconds;
+                const string &phase = phases[p].first;
+                size_t suffix = phase.size() - min(phase.size(), strlen(BENCH_TRACED_SUFFIX));
+                if (phase.compare(suffix, string::npos, BENCH_TRACED_SUFFIX) == 0 && phase_seconds[phase.substr(0, suffix)] > 0)
+                {
+                    cout << ", trace overhead " << 100 * (result.seconds / phase_seconds[phase.substr(0, suffix)] - 1) << "%";
+                }
+                map<string, double>::const_iterator old = baseline.find(key);
+                if (old != baseline.end() && old->second >= BENCH_MIN_COMPARED_SECONDS &&
+                    result.seconds > old->second * (1 + tolerance / 100))
+                {
+                    cout << "  REGRESSION from " << old->second << " s";
+                    regressions++;
+                }
+                cout << endl;
+            }
+            unlink(input_path);
         }
-        if (complete_num == processes.size())
-        { // all process completed
-            break;
-        }
     }
-    write_file(processes_done, output_path); // write output
-    return 1;
+    if (regressions > 0)
+    {
+        cout << regressions << " phases regressed by more than " << tolerance << "%" << endl;
+        return 1;
+    }
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 4)
+    if (argc >= 3 && strcmp(argv[1], "bench-load") == 0)
+    { // bench-load process_file [repeat]
+        return bench_load(argv[2], argc > 3 ? atoi(argv[3]) : 5);
+    }
+    if (argc >= 3 && strcmp(argv[1], "bench-policy") == 0)
+    { // bench-policy process_file [repeat]
+        return bench_policy(argv[2], argc > 3 ? atoi(argv[3]) : 5);
+    }
+    if (argc == 4 && strcmp(argv[1], "decode") == 0)
+    { // decode binary_log text_output
+        return decode_log(argv[2], argv[3]);
+    }
+    if (argc == 4 && strcmp(argv[1], "decode-trace") == 0)
+    { // decode-trace trace_file csv_output
+        return decode_trace(argv[2], argv[3]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "batch") == 0)
+    {
+        return batch(argc, argv);
+    }
+    if (argc >= 5 && strcmp(argv[1], "sweep") == 0)
+    {
+        return sweep(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0)
+    {
+        return bench_suite(argc, argv);
+    }
+    if (argc == 4 && strcmp(argv[1], "generate") == 0)
+    { // generate spec process_file
+        return generate(argv[2], argv[3]);
+    }
+    if (argc < 4)
     {
-        cout << "Incorrect inputs: has to be 4 arugments" << endl;
+        cerr << "Incorrect inputs: has to be at least 4 arugments" << endl;
         return 0;
     }
     const char *scheduling_algorithm = argv[1];
     const char *process_path = argv[2];
     const char *output_path = argv[3];
-    vector<process_t> process_queue = read_processes(process_path);
-    if (strcmp(scheduling_algorithm, "FCFS") == 0)
+    int output_format = OUTPUT_TEXT;
+    sched_params_t params;
+    string snapshot_path; // --resume=PATH continues the run a snapshot was taken from,
+    bool fork = false;    // --fork-at=PATH continues it with other time quanta or steal policy
+    bool stream = false;  // --stream reads the processes while the run goes and writes each one as it completes
+    int replications = 0; // --replications=N writes a Monte Carlo report of N runs instead of the output log
+    int num_threads = max(1u, thread::hardware_concurrency());
+    for (int i = 4; i < argc; i++)
     {
-        fcfs(process_queue, output_path);
+        vector<int> values;
+        if (strcmp(argv[i], "--stream") == 0)
+        {
+            stream = true;
+        }
+        else if (strncmp(argv[i], "--replications=", 15) == 0 && parse_int_list(argv[i] + 15, values, ",") && values.size() == 1 &&
+                 values[0] > 0)
+        {
+            replications = values[0];
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0 && parse_int_list(argv[i] + 10, values, ",") && values.size() == 1 &&
+                 values[0] > 0)
+        {
+            num_threads = values[0];
+        }
+        else if (strncmp(argv[i], "--resume=", 9) == 0)
+        {
+            snapshot_path = argv[i] + 9;
+            fork = false;
+        }
+        else if (strncmp(argv[i], "--fork-at=", 10) == 0)
+        {
+            snapshot_path = argv[i] + 10;
+            fork = true;
+        }
+        else if (!parse_run_option(argv[i], params, output_format))
+        {
+            return 1;
+        }
     }
-    else if (strcmp(scheduling_algorithm, "RR") == 0)
+    if (!is_algorithm(scheduling_algorithm))
     {
-        rr(process_queue, output_path);
+        cerr << "Wrong scheduling algorithm format, has to be FCFS, RR, FB, SPN, SRT, HRRN or CFS" << endl;
+        return 0;
     }
-    else if (strcmp(scheduling_algorithm, "FB") == 0)
+    if (stream && (!snapshot_path.empty() || !params.checkpoint_path.empty() || !params.trace_path.empty() || !params.lod_path.empty()))
+    { // these need the whole input again, or every process at the end of the run
+        cerr << "--stream cannot be combined with --checkpoint, --resume, --fork-at, --trace or --lod" << endl;
+        return 1;
+    }
+    if (replications > 0 &&
+        (stream || !snapshot_path.empty() || !params.checkpoint_path.empty() || !params.trace_path.empty() || !params.lod_path.empty()))
+    { // the replications only keep their summaries
+        cerr << "--replications cannot be combined with --stream, --checkpoint, --resume, --fork-at, --trace or --lod" << endl;
+        return 1;
+    }
+    workload_t workload;
+    stream_source_t stream_source(workload.resources);
+    if (stream)
     {
-        fb(process_queue, output_path);
+        if (!stream_source.open(process_path))
+        {
+            cerr << "Cannot open " << process_path << endl;
+            return 1;
+        }
+        workload.stream = &stream_source;
+    }
+    else if (!load_workload(process_path, workload))
+    {
+        return 1;
+    }
+    if (replications > 0)
+    {
+        return replicate(scheduling_algorithm, workload, params, replications, num_threads, output_path);
+    }
+    output_writer_t output;
+    if (snapshot_path.empty())
+    {
+        if (!output.open(output_path, output_format))
+        {
+            cerr << "Cannot open " << output_path << endl;
+            return 1;
+        }
+        output.live = stream;
+        if (run_algorithm(scheduling_algorithm, workload, params, output).failed || stream_source.failed)
+        {
+            output.close();
+            return 1;
+        }
     }
     else
     {
-        cout << "Wrong scheduling algorithm format, has to be FCFS or RR or FB" << endl;
+        snapshot_t snap;
+        snapshot_header_t header;
+        if (!snap.read(snapshot_path) || !header.restore(snap))
+        {
+            cerr << "Cannot read snapshot " << snapshot_path << endl;
+            return 1;
+        }
+        if (!header.fits(scheduling_algorithm, workload, params, output_format, fork))
+        {
+            return 1;
+        }
+        if (!output.resume(output_path, output_format, header.output_offset, header.output_path))
+        {
+            cerr << "Cannot continue the log of the snapshot in " << output_path << endl;
+            return 1;
+        }
+        if (run_algorithm(scheduling_algorithm, workload, params, output, &snap).failed)
+        {
+            output.close();
+            return 1;
+        }
+    }
+    if (!output.close())
+    {
+        cerr << "Cannot write " << output_path << endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,3085 @@
+#include "simulator_internal.h"
+
+bool get_varint(const vector<unsigned char> &data, size_t &pos, long long &value)
+{
+    unsigned long long v = 0;
+    for (int shift = 0; pos < data.size() && shift < 64; shift += 7)
+    {
+        unsigned char byte = data[pos++];
+        v |= (unsigned long long)(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            value = (long long)(v >> 1) ^ -(long long)(v & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+sched_params_t::sched_params_t()
+    : quantum(DEFAULT_QUANTUM), fb_levels(FB_LEVELS), fb_aging(0), fb_boost(0), min_granularity(DEFAULT_QUANTUM), mem_limit(0), seed(1), cpus(1),
+      steal(STEAL_BUSIEST), sim_threads(1), checkpoint_every(60), checkpoint_at(-1), profile(false) {}
+
+latency_histogram_t::latency_histogram_t() : buckets(HISTOGRAM_BUCKETS), count(0), max_value(0) {}
+
+int latency_histogram_t::bucket_of(long long value)
+{
+    if (value < HISTOGRAM_EXACT)
+    {
+        return value;
+    }
+    int exponent = 63 - __builtin_clzll(value); // at least 4
+    return HISTOGRAM_EXACT + (exponent - 4) * 16 + ((value >> (exponent - 4)) & 15);
+}
+
+long long latency_histogram_t::bucket_max(int bucket)
+{
+    if (bucket < HISTOGRAM_EXACT)
+    {
+        return bucket;
+    }
+    int shift = (bucket - HISTOGRAM_EXACT) / 16;
+    return ((17LL + (bucket - HISTOGRAM_EXACT) % 16) << shift) - 1;
+}
+
+void latency_histogram_t::add(long long value)
+{
+    value = max(value, 0LL);
+    this->buckets[bucket_of(value)]++;
+    this->count++;
+    this->max_value = max(this->max_value, value);
+}
+
+long long latency_histogram_t::percentile(double fraction) const
+{
+    long long rank = (long long)(fraction * this->count + 0.999999);
+    long long seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS && rank > 0; bucket++)
+    {
+        seen += this->buckets[bucket];
+        if (seen >= rank)
+        {
+            return min(bucket_max(bucket), this->max_value);
+        }
+    }
+    return this->max_value;
+}
+
+void latency_histogram_t::save(snapshot_t &snap) const
+{
+    snap.put(this->count);
+    snap.put(this->max_value);
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    { // most buckets are empty
+        if (this->buckets[bucket] != 0)
+        {
+            snap.put(bucket);
+            snap.put(this->buckets[bucket]);
+        }
+    }
+    snap.put(-1);
+}
+
+void latency_histogram_t::restore(snapshot_t &snap)
+{
+    this->count = snap.get();
+    this->max_value = snap.get();
+    for (int bucket = snap.get_int(-1, HISTOGRAM_BUCKETS - 1); bucket >= 0; bucket = snap.get_int(-1, HISTOGRAM_BUCKETS - 1))
+    {
+        this->buckets[bucket] = snap.get();
+    }
+}
+
+void queue_metrics_t::save(snapshot_t &snap) const
+{
+    snap.put(this->entries);
+    snap.put(this->total_wait);
+    snap.put(this->max_wait);
+}
+
+void queue_metrics_t::restore(snapshot_t &snap)
+{
+    this->entries = snap.get();
+    this->total_wait = snap.get();
+    this->max_wait = snap.get();
+}
+
+process_metrics_t run_summary_t::add(const process_t &p, const vector<service_t> &services, const vector<int> &drawn_costs, long long completion_tick)
+{
+    long long service_time = 0;
+    for (int i = 0; i < p.service_num; i++)
+    {
+        const service_t &ser = services[p.service_offset + i];
+        service_time += ser.draw < 0 ? ser.time_cost : drawn_costs[ser.draw];
+    }
+    process_metrics_t m;
+    m.completion_tick = completion_tick;
+    m.turnaround = completion_tick - p.arrival_time;
+    m.waiting = m.turnaround - service_time;
+    m.response = p.first_dispatch_tick - p.arrival_time;
+    this->completed++;
+    this->makespan = max(this->makespan, completion_tick);
+    this->total_turnaround += m.turnaround;
+    this->total_waiting += m.waiting;
+    this->total_response += m.response;
+    this->turnaround.add(m.turnaround);
+    this->waiting.add(m.waiting);
+    this->response.add(m.response);
+    return m;
+}
+
+void run_summary_t::save(snapshot_t &snap) const
+{
+    snap.put(this->completed);
+    snap.put(this->makespan);
+    snap.put_double(this->total_turnaround);
+    snap.put_double(this->total_waiting);
+    snap.put_double(this->total_response);
+    this->turnaround.save(snap);
+    this->waiting.save(snap);
+    this->response.save(snap);
+}
+
+void run_summary_t::restore(snapshot_t &snap)
+{
+    this->completed = snap.get();
+    this->makespan = snap.get();
+    this->total_turnaround = snap.get_double();
+    this->total_waiting = snap.get_double();
+    this->total_response = snap.get_double();
+    this->turnaround.restore(snap);
+    this->waiting.restore(snap);
+    this->response.restore(snap);
+}
+
+void trace_writer_t::next_block(int cpu)
+{
+    trace_buffer_t &buffer = this->buffers[cpu];
+    if (!this->threaded)
+    {
+        this->flush(cpu);
+        return;
+    }
+    if (++buffer.full == buffer.blocks.size())
+    { // a tick appended more than the blocks there are
+        buffer.blocks.push_back(unique_ptr<trace_block_t>(new trace_block_t));
+    }
+    buffer.block = buffer.blocks[buffer.full].get();
+    buffer.size = 0;
+}
+
+void lod_builder_t::add(const process_t &p, const working_log_t &log, int handle)
+{
+    if (p.process_id < 0 || this->failed)
+    {
+        return;
+    }
+    this->rows = max(this->rows, p.process_id + 1);
+    size_t b = p.process_id / LOD_TILE_ROWS;
+    if (b >= this->bands.size())
+    {
+        this->bands.resize(b + 1);
+    }
+    band_t &band = this->bands[b];
+    this->edges.clear();
+    log.for_each(handle, [this](int start_tick, int end_tick, int)
+                 {
+                     this->edges.push_back(make_pair(start_tick, 1));
+                     this->edges.push_back(make_pair(end_tick, -1));
+                     this->last_tick = max(this->last_tick, end_tick);
+                 });
+    sort(this->edges.begin(), this->edges.end());
+    size_t runs = band.runs.size();
+    int depth = 0; // intervals covering the ticks from the current edge on
+    for (size_t i = 0; i < this->edges.size();)
+    {
+        int tick = this->edges[i].first;
+        for (; i < this->edges.size() && this->edges[i].first == tick; i++)
+        {
+            depth += this->edges[i].second;
+        }
+        for (int column = tick; depth > 0 && column < this->edges[i].first;)
+        { // a run per tile the ticks up to the next edge cross
+            lod_run_t run;
+            run.column = column;
+            run.row = p.process_id % LOD_TILE_ROWS;
+            run.length = min(this->edges[i].first, (column / LOD_TILE_COLUMNS + 1) * LOD_TILE_COLUMNS) - column;
+            run.value = depth;
+            band.runs.push_back(run);
+            column += run.length;
+        }
+    }
+    this->pending_runs += band.runs.size() - runs;
+    if (--band.pending == 0)
+    { // the band is complete
+        this->spill(band);
+    }
+    if (this->pending_runs <= LOD_PENDING_RUNS)
+    {
+        return;
+    }
+    while (this->pending_runs > LOD_PENDING_RUNS / 2 && !this->failed)
+    { // the biggest bands, until half of the limit is left
+        band_t *biggest = &this->bands[0];
+        for (size_t i = 1; i < this->bands.size(); i++)
+        {
+            if (this->bands[i].runs.size() > biggest->runs.size())
+            {
+                biggest = &this->bands[i];
+            }
+        }
+        this->spill(*biggest);
+    }
+}
+
+bool lod_builder_t::spill(band_t &band)
+{
+    if (band.runs.empty() || this->failed)
+    {
+        return !this->failed;
+    }
+    if (this->spill_file == NULL && (this->spill_file = tmpfile()) == NULL)
+    {
+        cerr << "Cannot create a temporary file for the level-of-detail pyramid" << endl;
+        this->failed = true;
+        return false;
+    }
+    stable_sort(band.runs.begin(), band.runs.end(), [](const lod_run_t &a, const lod_run_t &b)
+         {
+             int a_tile = a.column / LOD_TILE_COLUMNS;
+             int b_tile = b.column / LOD_TILE_COLUMNS;
+             return a_tile != b_tile ? a_tile < b_tile : a.row != b.row ? a.row < b.row : a.column < b.column;
+         });
+    if (fwrite(band.runs.data(), sizeof(lod_run_t), band.runs.size(), this->spill_file) != band.runs.size())
+    {
+        cerr << "Cannot write the level-of-detail pyramid to a temporary file" << endl;
+        this->failed = true;
+        return false;
+    }
+    chunk_t chunk = {this->spill_size, (int)band.runs.size()};
+    band.chunks.push_back(chunk);
+    this->spill_size += band.runs.size() * sizeof(lod_run_t);
+    this->pending_runs -= band.runs.size();
+    vector<lod_run_t>().swap(band.runs);
+    return true;
+}
+
+// Sequential reader of a chunk of runs of one band
+struct lod_reader_t
+{
+    int fd;
+    int band;
+    long long offset; // of the next runs not read into the buffer yet
+    int left;         // runs of the chunk not read into the buffer yet
+    vector<lod_run_t> buffer;
+    size_t pos, end;
+    bool failed;
+    lod_reader_t(FILE *file, const lod_builder_t::chunk_t &chunk, int band)
+        : fd(fileno(file)), band(band), offset(chunk.offset), left(chunk.runs), buffer(LOD_READ_RUNS), pos(0), end(0), failed(false)
+    {
+        this->fill();
+    }
+    void fill()
+    {
+        int n = min(this->left, LOD_READ_RUNS);
+        ssize_t size = n * sizeof(lod_run_t);
+        this->failed = this->failed || pread(this->fd, this->buffer.data(), size, this->offset) != size;
+        this->offset += size;
+        this->left -= n;
+        this->pos = 0;
+        this->end = this->failed ? 0 : n;
+    }
+    bool done() const { return this->pos == this->end; }
+    const lod_run_t &run() const { return this->buffer[this->pos]; }
+    void next()
+    {
+        if (++this->pos == this->end && this->left > 0)
+        {
+            this->fill();
+        }
+    }
+};
+
+// Add `value` to the cells of `row` from column `begin` to `end` of a tile, an edge is keyed by its row and
+// column in the tile
+void add_lod_edges(vector<pair<int, long long> > &edges, int row, long long begin, long long end, long long value)
+{
+    if (begin < end)
+    {
+        edges.push_back(make_pair(row * (LOD_TILE_COLUMNS + 1) + (int)begin, value));
+        edges.push_back(make_pair(row * (LOD_TILE_COLUMNS + 1) + (int)end, -value));
+    }
+}
+
+bool lod_builder_t::write(const char *file_path)
+{
+    for (size_t b = 0; b < this->bands.size(); b++)
+    { // the processes that are still expected never completed
+        this->spill(this->bands[b]);
+    }
+    if (this->failed)
+    {
+        return false;
+    }
+    if (this->spill_file != NULL)
+    {
+        fflush(this->spill_file);
+    }
+    output_writer_t file;
+    if (!file.open(file_path, OUTPUT_TEXT))
+    {
+        return false;
+    }
+    file.put_bytes(LOD_MAGIC, 4);
+    int time_levels = levels_to_fit(this->last_tick, LOD_TILE_COLUMNS);
+    int row_levels = levels_to_fit(this->rows, LOD_TILE_ROWS);
+    int top = max(time_levels, row_levels);
+    vector<int> directory = {this->rows, this->last_tick, top + 1};
+    // chunks of the level below, per band, the bands of level 0 to start with
+    FILE *in_file = this->spill_file;
+    this->spill_file = NULL;
+    vector<vector<chunk_t> > in_chunks(this->bands.size());
+    for (size_t b = 0; b < this->bands.size(); b++)
+    {
+        in_chunks[b].swap(this->bands[b].chunks);
+    }
+    long long in_ticks = 1, in_group = 1;
+    vector<pair<int, long long> > edges; // the change of the value from a cell of the tile on
+    vector<lod_run_t> runs;
+    bool ok = true;
+    for (int level = 0; level <= top && ok; level++)
+    {
+        long long ticks = 1LL << 2 * max(0, level - (top - time_levels));
+        long long group = 1LL << 2 * max(0, level - (top - row_levels));
+        long long tf = ticks / in_ticks, gf = group / in_group; // cells of the level below across and down a cell
+        FILE *out_file = NULL;
+        if (level < top && (out_file = tmpfile()) == NULL)
+        {
+            cerr << "Cannot create a temporary file for the level-of-detail pyramid" << endl;
+            ok = false;
+            break;
+        }
+        long long out_size = 0;
+        vector<vector<chunk_t> > out_chunks((in_chunks.size() + gf - 1) / gf);
+        directory.push_back(ticks);
+        directory.push_back(group);
+        size_t tile_count = directory.size();
+        directory.push_back(0);
+        for (size_t band = 0; band < out_chunks.size() && ok; band++)
+        {
+            vector<lod_reader_t> readers;
+            for (size_t b = band * gf; b < min(in_chunks.size(), (size_t)((band + 1) * gf)); b++)
+            {
+                for (size_t i = 0; i < in_chunks[b].size(); i++)
+                {
+                    readers.push_back(lod_reader_t(in_file, in_chunks[b][i], b));
+                }
+            }
+            chunk_t chunk = {out_size, 0};
+            while (true)
+            {
+                long long tile = -1; // column of the next tile in the level
+                for (size_t r = 0; r < readers.size(); r++)
+                {
+                    if (!readers[r].done() && (tile < 0 || readers[r].run().column / LOD_TILE_COLUMNS / tf < tile))
+                    {
+                        tile = readers[r].run().column / LOD_TILE_COLUMNS / tf;
+                    }
+                }
+                if (tile < 0)
+                {
+                    break;
+                }
+                edges.clear();
+                for (size_t r = 0; r < readers.size(); r++)
+                { // every cell below adds its busy ticks to the cell it falls into
+                    for (; !readers[r].done() && readers[r].run().column / LOD_TILE_COLUMNS / tf == tile; readers[r].next())
+                    {
+                        const lod_run_t &run = readers[r].run();
+                        int row = (readers[r].band * LOD_TILE_ROWS + run.row) / gf - band * LOD_TILE_ROWS;
+                        long long begin = run.column - tile * tf * LOD_TILE_COLUMNS, end = begin + run.length;
+                        long long first = begin / tf, last = (end - 1) / tf;
+                        if (first == last)
+                        {
+                            add_lod_edges(edges, row, first, first + 1, run.value * (end - begin));
+                            continue;
+                        }
+                        add_lod_edges(edges, row, first, first + 1, run.value * ((first + 1) * tf - begin));
+                        add_lod_edges(edges, row, first + 1, last, run.value * tf);
+                        add_lod_edges(edges, row, last, last + 1, run.value * (end - last * tf));
+                    }
+                }
+                sort(edges.begin(), edges.end(), [](const pair<int, long long> &a, const pair<int, long long> &b)
+                     { return a.first < b.first; });
+                runs.clear();
+                long long value = 0;
+                for (size_t i = 0; i < edges.size();)
+                {
+                    int at = edges[i].first;
+                    for (; i < edges.size() && edges[i].first == at; i++)
+                    {
+                        value += edges[i].second;
+                    }
+                    if (value != 0)
+                    { // the value holds up to the next edge, which is in the same row
+                        lod_run_t run;
+                        run.column = tile * LOD_TILE_COLUMNS + at % (LOD_TILE_COLUMNS + 1);
+                        run.row = at / (LOD_TILE_COLUMNS + 1);
+                        run.length = edges[i].first - at;
+                        run.value = value;
+                        runs.push_back(run);
+                    }
+                }
+                if (out_file != NULL && fwrite(runs.data(), sizeof(lod_run_t), runs.size(), out_file) != runs.size())
+                {
+                    cerr << "Cannot write the level-of-detail pyramid to a temporary file" << endl;
+                    ok = false;
+                    break;
+                }
+                out_size += runs.size() * sizeof(lod_run_t);
+                chunk.runs += runs.size();
+                long long offset = file.flushed + file.used;
+                int tile_runs = 0;
+                lod_run_t pending = {-1, 0, 0, 0};
+                for (size_t i = 0; i < runs.size(); i++)
+                {
+                    lod_run_t run = runs[i];
+                    run.value = min(255LL, (255 * run.value + ticks * group - 1) / (ticks * group));
+                    if (pending.row == run.row && pending.column + pending.length == run.column && pending.value == run.value)
+                    {
+                        pending.length += run.length;
+                        continue;
+                    }
+                    if (pending.column >= 0)
+                    {
+                        put_run(file, pending);
+                        tile_runs++;
+                    }
+                    pending = run;
+                }
+                put_run(file, pending);
+                tile_runs++;
+                directory.push_back(band);
+                directory.push_back(tile);
+                directory.push_back(tile_runs);
+                directory.push_back((int)(offset & 0xffffffff));
+                directory.push_back((int)(offset >> 32));
+                directory[tile_count]++;
+            }
+            for (size_t r = 0; r < readers.size(); r++)
+            {
+                ok = ok && !readers[r].failed;
+            }
+            if (chunk.runs > 0)
+            {
+                out_chunks[band].push_back(chunk);
+            }
+        }
+        if (in_file != NULL)
+        {
+            fclose(in_file);
+        }
+        if (out_file != NULL)
+        {
+            fflush(out_file);
+        }
+        in_file = out_file;
+        in_chunks.swap(out_chunks);
+        in_ticks = ticks;
+        in_group = group;
+    }
+    if (in_file != NULL)
+    {
+        fclose(in_file);
+    }
+    long long offset = file.flushed + file.used;
+    for (size_t i = 0; i < directory.size(); i += OUTPUT_BUFFER_SIZE / sizeof(int))
+    { // a piece at a time, the buffer of the writer has a fixed size
+        size_t n = min(directory.size() - i, OUTPUT_BUFFER_SIZE / sizeof(int));
+        file.put_bytes((const char *)&directory[i], n * sizeof(int));
+    }
+    int trailer[2] = {(int)(offset & 0xffffffff), (int)(offset >> 32)};
+    file.put_bytes((const char *)trailer, sizeof(trailer));
+    return file.close() && ok;
+}
+
+void write_done_processes(vector<process_t> &processes, const vector<service_t> &services, const vector<int> &drawn_costs,
+                          ring_queue_t &processes_done, working_log_t &working, int completion_tick, output_writer_t &output,
+                          run_summary_t &summary)
+{
+    while (!processes_done.empty())
+    {
+        int handle = processes_done.pop_front();
+        process_t &p = processes[handle];
+        process_metrics_t m = summary.add(p, services, drawn_costs, completion_tick);
+        if (output.format == OUTPUT_METRICS)
+        {
+            output.write_process_metrics(p, m);
+        }
+        if (handle < (int)working.lists.size())
+        { // working intervals are only logged for an output that needs them
+            output.write_process(p, working, handle);
+            working.release(handle);
+        }
+        if (output.live && processes_done.empty())
+        {
+            output.flush();
+        }
+    }
+}
+
+void write_metrics_report(output_writer_t &output, const run_summary_t &summary)
+{
+    char line[256];
+    output.put_text("\nmetric,mean,p50,p95,p99,max\n");
+    const latency_histogram_t *histograms[] = {&summary.turnaround, &summary.waiting, &summary.response};
+    const double totals[] = {summary.total_turnaround, summary.total_waiting, summary.total_response};
+    const char *names[] = {"turnaround", "waiting", "response"};
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(line, sizeof(line), "%s,%.3f,%lld,%lld,%lld,%lld\n", names[i], summary.average(totals[i]), histograms[i]->percentile(0.5),
+                 histograms[i]->percentile(0.95), histograms[i]->percentile(0.99), histograms[i]->max_value);
+        output.put_text(line);
+    }
+    output.put_text("\ncpu,busy_ticks,utilisation\n");
+    for (size_t cpu = 0; cpu < summary.cpu_busy_ticks.size(); cpu++)
+    {
+        snprintf(line, sizeof(line), "%d,%lld,%.6f\n", (int)cpu, summary.cpu_busy_ticks[cpu],
+                 summary.makespan == 0 ? 0 : (double)summary.cpu_busy_ticks[cpu] / summary.makespan);
+        output.put_text(line);
+    }
+    output.put_text("\nqueue,entries,mean_wait,max_wait\n");
+    for (size_t i = 0; i < summary.queues.size(); i++)
+    {
+        const queue_metrics_t &q = summary.queues[i].second;
+        snprintf(line, sizeof(line), ",%lld,%.3f,%lld\n", q.entries, q.entries == 0 ? 0 : (double)q.total_wait / q.entries, q.max_wait);
+        output.put_text(summary.queues[i].first + line);
+    }
+    snprintf(line, sizeof(line), "\ncompleted,makespan,utilisation,throughput\n%lld,%lld,%.6f,%.6f\n", summary.completed, summary.makespan,
+             summary.cpu_utilisation(), summary.throughput());
+    output.put_text(line);
+}
+
+void split(const string &s, vector<string> &tokens, const string &delim)
+{
+    string::size_type last_pos = s.find_first_not_of(delim, 0);
+    string::size_type pos = s.find_first_of(delim, last_pos);
+    while (string::npos != pos || string::npos != last_pos)
+    {
+        tokens.push_back(s.substr(last_pos, pos - last_pos));
+        last_pos = s.find_first_not_of(delim, pos);
+        pos = s.find_first_of(delim, last_pos);
+    }
+}
+
+bool arrives_before(const process_t &a, const process_t &b)
+{
+    if (a.arrival_time != b.arrival_time)
+    {
+        return a.arrival_time < b.arrival_time;
+    }
+    return a.process_id < b.process_id;
+}
+
+vector<process_t> read_processes(const char *file_path, vector<service_t> &services, resource_table_t &resources)
+{
+    vector<process_t> process_queue;
+    ifstream file(file_path);
+    string str;
+    while (getline(file, str))
+    {
+        process_t new_process;
+        stringstream ss(str);
+        int service_num;
+        char syntax;
+        ss >> syntax >> new_process.process_id >> new_process.arrival_time >> service_num;
+        if (!(ss >> new_process.weight))
+        { // no CFS weight in the header
+            new_process.weight = CFS_DEFAULT_WEIGHT;
+        }
+        new_process.service_offset = services.size();
+        new_process.service_num = service_num;
+        for (int i = 0; i < service_num; i++)
+        { // read services sequence
+            getline(file, str);
+            str = str.erase(str.find_last_not_of(" \n\r\t") + 1);
+            vector<string> tokens;
+            split(str, tokens, " ");
+            service_t ser(tokens, resources);
+            services.push_back(ser);
+        }
+        new_process.cur_service_idx = 0;
+        new_process.cur_service_tick = 0;
+        process_queue.push_back(new_process);
+    }
+    // processes arriving at the same tick are admitted in ascending order of their IDs
+    sort(process_queue.begin(), process_queue.end(), arrives_before);
+    return process_queue;
+}
+
+bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// The cursor helpers work on a local copy of the cursor position: a `const char *` read may alias
+// any other object, so going through `in.pos` would reload it on every character
+void skip_blanks(input_cursor_t &in)
+{
+    const char *p = in.pos;
+    while (p < in.end && is_blank(*p))
+    {
+        p++;
+    }
+    in.pos = p;
+}
+
+bool parse_int(input_cursor_t &in, int &value)
+{
+    skip_blanks(in);
+    const char *p = in.pos, *end = in.end;
+    bool negative = p < end && *p == '-';
+    if (negative)
+    {
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        v = v * 10 + (*p - '0');
+        if (v > INT_MAX)
+        {
+            return false;
+        }
+        p++;
+    }
+    in.pos = p;
+    value = negative ? -v : v;
+    return p >= end || is_blank(*p) || *p == '\n';
+}
+
+bool parse_word(input_cursor_t &in, string &word)
+{
+    skip_blanks(in);
+    const char *p = in.pos;
+    while (p < in.end && !is_blank(*p) && *p != '\n')
+    {
+        p++;
+    }
+    bool found = p != in.pos;
+    word.assign(in.pos, p);
+    in.pos = p;
+    return found;
+}
+
+bool next_line(input_cursor_t &in)
+{
+    skip_blanks(in);
+    if (in.pos < in.end)
+    {
+        if (*in.pos != '\n')
+        {
+            return false;
+        }
+        in.pos++;
+    }
+    in.line++;
+    return true;
+}
+
+bool parse_error(const input_cursor_t &in, const char *file_path, const char *message)
+{
+    cerr << file_path << ":" << in.line << ": " << message << endl;
+    return false;
+}
+
+size_t count_char(const char *begin, const char *end, char c)
+{
+    size_t n = 0;
+    while ((begin = (const char *)memchr(begin, c, end - begin)) != NULL)
+    {
+        n++;
+        begin++;
+    }
+    return n;
+}
+
+bool parse_processes(input_cursor_t &in, const char *file_path, vector<process_t> &processes, vector<service_t> &services,
+                     resource_table_t &resources, vector<distribution_t> *dists)
+{
+    string name; // mutex or device name of the current service
+    while (true)
+    {
+        skip_blanks(in);
+        if (in.pos >= in.end)
+        {
+            return true;
+        }
+        if (*in.pos == '\n')
+        { // blank line between processes
+            next_line(in);
+            continue;
+        }
+        if (*in.pos != '#')
+        {
+            return parse_error(in, file_path, "expected \"# process_id arrival_time service_number\"");
+        }
+        in.pos++;
+        process_t new_process;
+        if (!parse_int(in, new_process.process_id) || !parse_int(in, new_process.arrival_time) ||
+            !parse_int(in, new_process.service_num))
+        {
+            return parse_error(in, file_path, "expected \"# process_id arrival_time service_number\"");
+        }
+        skip_blanks(in);
+        if (in.pos < in.end && *in.pos != '\n' &&
+            (!parse_int(in, new_process.weight) || new_process.weight <= 0 || new_process.weight > CFS_MAX_WEIGHT))
+        {
+            return parse_error(in, file_path, "expected a CFS weight from 1 to 1048576 after the service number");
+        }
+        if (!next_line(in))
+        {
+            return parse_error(in, file_path, "expected \"# process_id arrival_time service_number [weight]\"");
+        }
+        if (new_process.service_num <= 0)
+        {
+            return parse_error(in, file_path, "a process needs at least one service");
+        }
+        new_process.service_offset = services.size();
+        new_process.cur_service_idx = 0;
+        new_process.cur_service_tick = 0;
+        for (int i = 0; i < new_process.service_num; i++)
+        { // read services sequence
+            skip_blanks(in);
+            if (in.pos >= in.end || *in.pos == '\n' || *in.pos == '#')
+            {
+                return parse_error(in, file_path, "fewer services than the process header announces");
+            }
+            service_t ser;
+            char type = *in.pos++;
+            if (in.pos < in.end && !is_blank(*in.pos) && *in.pos != '\n')
+            {
+                return parse_error(in, file_path, "expected service type C, K, D, L or U");
+            }
+            switch (type)
+            {
+            case 'D':
+            { // "D <cost>" uses the default disk, "D <device> <cost>" a named one
+                input_cursor_t cost_in = in;
+                bool named = parse_word(in, name);
+                skip_blanks(in);
+                if (named && in.pos < in.end && *in.pos != '\n')
+                {
+                    ser.resource = resources.device_id(name);
+                }
+                else
+                {
+                    in = cost_in;
+                    ser.resource = DEVICE_DISK;
+                }
+            }
+            // fall through
+            case 'C':
+            case 'K':
+                ser.type = type == 'C' ? SERVICE_C : type == 'K' ? SERVICE_K : SERVICE_D;
+                if (type == 'K')
+                {
+                    ser.resource = DEVICE_KEYBOARD;
+                }
+                if (parse_int(in, ser.time_cost))
+                {
+                    if (ser.time_cost < 0)
+                    {
+                        return parse_error(in, file_path, "expected a non-negative number of ticks");
+                    }
+                }
+                else
+                { // a distribution, drawn again by every run (sim_state_t::drawn_costs); time_cost holds its rounded mean
+                    distribution_t dist;
+                    if (!parse_word(in, name) || !dist.parse(name))
+                    {
+                        return parse_error(in, file_path, "expected a non-negative number of ticks or a distribution");
+                    }
+                    if (dists == NULL)
+                    {
+                        return parse_error(in, file_path, "a stochastic service cost needs a workload loaded up front");
+                    }
+                    ser.time_cost = (int)(dist.mean + 0.5);
+                    ser.draw = dists->size();
+                    dists->push_back(dist);
+                }
+                break;
+            case 'L':
+            case 'U':
+                ser.type = type == 'L' ? SERVICE_L : SERVICE_U;
+                ser.time_cost = 0;
+                if (!parse_word(in, name))
+                {
+                    return parse_error(in, file_path, "expected a mutex name");
+                }
+                ser.resource = resources.mutex_id(name);
+                break;
+            default:
+                return parse_error(in, file_path, "expected service type C, K, D, L or U");
+            }
+            if (!next_line(in))
+            {
+                return parse_error(in, file_path, "unexpected text after the service description");
+            }
+            services.push_back(ser);
+        }
+        processes.push_back(new_process);
+    }
+}
+
+bool load_processes(const char *file_path, vector<process_t> &processes, vector<service_t> &services, resource_table_t &resources,
+                    vector<distribution_t> *dists)
+{
+    int fd = open(file_path, O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0)
+    {
+        cerr << "Cannot open " << file_path << endl;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    bool parsed = true;
+    if (file_stat.st_size > 0)
+    {
+        void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            cerr << "Cannot map " << file_path << endl;
+            close(fd);
+            return false;
+        }
+        madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+        input_cursor_t in = {(const char *)data, (const char *)data + file_stat.st_size, 1};
+        // size the storage up front: at most one process per '#' and one service per line
+        processes.reserve(processes.size() + count_char(in.pos, in.end, '#'));
+        services.reserve(services.size() + count_char(in.pos, in.end, '\n') + 1);
+        parsed = parse_processes(in, file_path, processes, services, resources, dists);
+        munmap(data, file_stat.st_size);
+    }
+    close(fd);
+    if (!is_sorted(processes.begin(), processes.end(), arrives_before))
+    { // processes arriving at the same tick are admitted in ascending order of their IDs
+        sort(processes.begin(), processes.end(), arrives_before);
+    }
+    return parsed;
+}
+
+bool write_synthetic_workload(const synthetic_spec_t &spec, const char *file_path)
+{
+    output_writer_t output;
+    if (!output.open(file_path, OUTPUT_TEXT))
+    {
+        return false;
+    }
+    synthetic_source_t source(spec);
+    vector<service_t> services(spec.max_services());
+    process_t p;
+    while (source.next_arrival() != NO_EVENT)
+    {
+        source.next(p, services.data());
+        output.put_bytes("# ", 2);
+        output.put_int(p.process_id, ' ');
+        output.put_int(p.arrival_time, ' ');
+        output.put_int(p.service_num, '\n');
+        for (int i = 0; i < p.service_num; i++)
+        {
+            const service_t &ser = services[i];
+            const char *names = "CKDLU";
+            output.put_bytes(names + ser.type, 1);
+            if (ser.type == SERVICE_L || ser.type == SERVICE_U)
+            {
+                output.put_text(" m");
+                output.put_int(ser.resource, '\n');
+            }
+            else
+            {
+                output.put_bytes(" ", 1);
+                output.put_int(ser.time_cost, '\n');
+            }
+        }
+    }
+    return output.close();
+}
+
+bool stream_source_t::open(const char *file_path)
+{
+    this->path = strcmp(file_path, "-") == 0 ? "stdin" : file_path;
+    this->file = strcmp(file_path, "-") == 0 ? stdin : fopen(file_path, "r");
+    return this->file != NULL;
+}
+
+void stream_source_t::read_record()
+{
+    string text;
+    int first_line = 0;
+    int services = -1; // service lines of the record left to read, -1 before its header
+    while (services != 0)
+    {
+        ssize_t n = getline(&this->line_buffer, &this->line_capacity, this->file);
+        if (n < 0)
+        { // the parser reports a record cut short
+            break;
+        }
+        this->line++;
+        input_cursor_t in = {this->line_buffer, this->line_buffer + n, this->line};
+        skip_blanks(in);
+        if (services < 0 && (in.pos >= in.end || *in.pos == '\n'))
+        { // blank line between processes
+            continue;
+        }
+        if (services < 0)
+        { // a malformed header stops the record after its own line
+            int process_id, arrival_time;
+            first_line = this->line;
+            bool header = *in.pos++ == '#';
+            if (!header || !parse_int(in, process_id) || !parse_int(in, arrival_time) || !parse_int(in, services))
+            {
+                services = 0;
+            }
+            services = max(services, 0);
+        }
+        else
+        {
+            services--;
+        }
+        text.append(this->line_buffer, n);
+    }
+    if (text.empty())
+    {
+        this->at_end = true;
+        return;
+    }
+    input_cursor_t in = {text.data(), text.data() + text.size(), first_line};
+    vector<process_t> processes;
+    record_t record;
+    if (!parse_processes(in, this->path.c_str(), processes, record.services, this->resources))
+    {
+        this->failed = true;
+        return;
+    }
+    record.process = processes[0];
+    record.process.service_offset = 0;
+    if (record.process.arrival_time < 0)
+    { // never admitted, as in a process file
+        return;
+    }
+    if (record.process.arrival_time < this->last_arrival)
+    {
+        cerr << this->path << ":" << first_line << ": process " << record.process.process_id << " arrives at tick "
+             << record.process.arrival_time << ", before the process read before it" << endl;
+        this->failed = true;
+        return;
+    }
+    this->last_arrival = record.process.arrival_time;
+    deque<record_t>::iterator pos = upper_bound(this->pending.begin(), this->pending.end(), record.process,
+                                                [](const process_t &p, const record_t &r)
+                                                { return arrives_before(p, r.process); });
+    this->pending.insert(pos, record);
+}
+
+#define DISPATCH_PENDING -2 // peek(): a process will be dispatched next tick, but which one is not known yet
+
+// Scheduling policies plug into policy_run_t through the hooks below. policy_run_t is instantiated once per
+// policy, so the hooks are inlined into the tick loop and cost no virtual call:
+//   on_arrival(h)    a new process is admitted
+//   on_unblock(h)    a process is back from an I/O device or has got its mutex
+//   select_next()    the process to run on CPU in this tick, -1 if there is none
+//   on_leave()       the selected process blocks or completes
+//   on_preempt()     the selected process is taken off the CPU but stays ready
+//   quantum()        time quantum of the selected process, NO_EVENT if the clock never preempts it
+//   should_preempt() a ready process should take over the CPU from the selected one before it runs
+//   peek(quantum)    what select_next() and quantum() would return next tick, without side effects
+//   quiet_ticks()    ticks the run queue stays as it is unless processes come or go, NO_EVENT if forever
+//   load()           number of processes in the run queue, the selected one included
+//   stealable()      number of processes another CPU may take with steal()
+//   steal()          remove a ready process that is not about to run, the least urgent one
+//   save(snap)       write the run queue to a snapshot
+//   restore(snap)    read it back into an empty policy, after the simulation state
+// With more than one CPU every CPU has its own policy object, which is its run queue.
+
+// First-Come-First-Served: one FIFO ready queue, the running process stays at its front
+struct fcfs_policy_t
+{
+    sim_state_t &sim;
+    ring_queue_t ready_queue;
+    fcfs_policy_t(sim_state_t &sim) : sim(sim), ready_queue(sim.queue_capacity()) {}
+
+    void on_arrival(int handle)
+    {
+        this->ready_queue.push_back(handle);
+    }
+    void on_unblock(int handle)
+    {
+        this->ready_queue.push_back(handle);
+    }
+    int select_next()
+    {
+        return this->ready_queue.empty() ? -1 : this->ready_queue.front(); // always dispatch the first process in ready queue
+    }
+    void on_leave()
+    {
+        this->ready_queue.pop_front();
+    }
+    void on_preempt() {}
+    int quantum() const
+    {
+        return NO_EVENT;
+    }
+    bool should_preempt() const
+    {
+        return false;
+    }
+    int quiet_ticks() const
+    {
+        return NO_EVENT;
+    }
+    int peek(int &quantum) const
+    {
+        quantum = this->quantum();
+        return this->ready_queue.empty() ? -1 : this->ready_queue.front();
+    }
+    int load() const
+    {
+        return this->ready_queue.size();
+    }
+    int stealable() const
+    { // the front is kept for this CPU
+        return max(this->ready_queue.size() - 1, 0);
+    }
+    int steal()
+    {
+        return this->ready_queue.pop_back();
+    }
+    void save(snapshot_t &snap) const
+    {
+        snap.put_queue(this->ready_queue);
+    }
+    void restore(snapshot_t &snap)
+    {
+        snap.get_queue(this->ready_queue, this->sim.processes.size());
+    }
+};
+
+// Round Robin: FCFS with clock interrupts every params.quantum ticks
+struct rr_policy_t : fcfs_policy_t
+{
+    rr_policy_t(sim_state_t &sim) : fcfs_policy_t(sim) {}
+
+    void on_preempt()
+    {
+        move_process_from(this->ready_queue, this->ready_queue); //put process to the tail of ready_queue
+    }
+    int quantum() const
+    {
+        return this->sim.params.quantum;
+    }
+    int peek(int &quantum) const
+    {
+        quantum = this->quantum();
+        return this->ready_queue.empty() ? -1 : this->ready_queue.front();
+    }
+};
+
+// Feedback: one RR queue per priority level, preempted processes are demoted to the next level. Bit l of
+// `ready_levels` is set while RQl is non-empty, so the highest priority one is found with a single
+// find-first-set. With aging every level below RQ0 moves up by one every params.fb_aging ticks, with a
+// boost all of them move to RQ0 every params.fb_boost ticks; a whole queue moves at once. The level of a
+// ready process is only written to its `priority` once it is dispatched or stolen
+struct fb_policy_t
+{
+    sim_state_t &sim;
+    vector<ring_queue_t> ready_queues; // RQ0 has the highest priority, the lower levels grow as they fill
+    unsigned long long ready_levels;   // bit l is set if RQl is not empty
+    int cur_level;                     // level of the process returned by select_next()
+    int next_aging;                    // tick of the next aging, INT_MAX without
+    int next_boost;                    // tick of the next boost, INT_MAX without
+    fb_policy_t(sim_state_t &sim)
+        : sim(sim), ready_queues(sim.params.levels(), ring_queue_t(1)), ready_levels(0), cur_level(0),
+          next_aging(sim.params.fb_aging > 0 ? sim.params.fb_aging : INT_MAX), next_boost(sim.params.fb_boost > 0 ? sim.params.fb_boost : INT_MAX)
+    {
+        this->ready_queues[0] = ring_queue_t(sim.queue_capacity());
+    }
+
+    void push(int level, int handle)
+    {
+        this->ready_queues[level].push_back(handle);
+        this->ready_levels |= 1ULL << level;
+    }
+    int pop_front(int level)
+    {
+        int handle = this->ready_queues[level].pop_front();
+        if (this->ready_queues[level].empty())
+        {
+            this->ready_levels &= ~(1ULL << level);
+        }
+        return handle;
+    }
+    void on_arrival(int handle)
+    {
+        this->sim.processes[handle].priority = 0; //set highest priority for new processes
+        this->push(0, handle);                    // add new process to queue with highest priority
+    }
+    void on_unblock(int handle)
+    { //re-insert to the tail of same ready queue where it was dispatched earlier
+        this->push(this->sim.processes[handle].priority, handle);
+    }
+    // index of the highest priority non-empty queue, -1 if all are empty
+    int first_ready_level() const
+    {
+        return this->ready_levels == 0 ? -1 : __builtin_ctzll(this->ready_levels);
+    }
+    // Move every ready level below RQ0 up by `up` levels, RQ0 at most. The processes already in a level
+    // stay ahead of those moving in
+    void promote(int up)
+    {
+        unsigned long long lower = this->ready_levels & ~1ULL;
+        while (lower != 0)
+        {
+            int level = __builtin_ctzll(lower);
+            lower &= lower - 1;
+            int target = max(level - up, 0);
+            ring_queue_t &from = this->ready_queues[level];
+            ring_queue_t &to = this->ready_queues[target];
+            if (to.empty())
+            {
+                swap(from, to);
+            }
+            else
+            {
+                while (!from.empty())
+                {
+                    to.push_back(from.pop_front());
+                }
+            }
+            this->ready_levels = (this->ready_levels & ~(1ULL << level)) | 1ULL << target;
+        }
+    }
+    int select_next()
+    {
+        int tick = this->sim.cur_tick;
+        if (tick >= this->next_aging || tick >= this->next_boost)
+        { // both never pass by unseen, see quiet_ticks()
+            this->promote(tick >= this->next_boost ? (int)this->ready_queues.size() : 1);
+            if (tick >= this->next_aging)
+            {
+                this->next_aging = (int)min((long long)tick + this->sim.params.fb_aging, (long long)INT_MAX);
+            }
+            if (tick >= this->next_boost)
+            {
+                this->next_boost = (int)min((long long)tick + this->sim.params.fb_boost, (long long)INT_MAX);
+            }
+        }
+        this->cur_level = this->first_ready_level();
+        if (this->cur_level < 0)
+        {
+            return -1;
+        }
+        int handle = this->ready_queues[this->cur_level].front();
+        this->sim.processes[handle].priority = this->cur_level;
+        return handle;
+    }
+    void on_leave()
+    {
+        this->pop_front(this->cur_level);
+    }
+    void on_preempt()
+    {
+        int lowest = this->ready_queues.size() - 1;
+        if (this->cur_level != lowest)
+        { // if process was not in a queue with lowest priority, update its priority and move it to respective queue
+            this->sim.processes[this->ready_queues[this->cur_level].front()].priority++;
+            this->push(this->cur_level + 1, this->pop_front(this->cur_level));
+        }
+        else
+        { // if process is already in a queue with lowest priority put it to the tail of that queue
+            move_process_from(this->ready_queues[lowest], this->ready_queues[lowest]);
+        }
+    }
+    int quantum() const
+    {
+        return this->sim.params.level_quantum(this->cur_level);
+    }
+    bool should_preempt() const
+    {
+        return false;
+    }
+    int peek(int &quantum) const
+    {
+        int level = this->first_ready_level();
+        if (level < 0)
+        {
+            return -1;
+        }
+        quantum = this->sim.params.level_quantum(level);
+        return this->ready_queues[level].front();
+    }
+    // Ticks before the run queue changes by itself: aging and boosts reorder it and change the quantum
+    // of the running process
+    int quiet_ticks() const
+    {
+        int next = min(this->next_aging, this->next_boost);
+        return next == INT_MAX ? NO_EVENT : max(next - this->sim.cur_tick - 1, 0);
+    }
+    int load() const
+    {
+        int n = 0;
+        for (unsigned long long levels = this->ready_levels; levels != 0; levels &= levels - 1)
+        {
+            n += this->ready_queues[__builtin_ctzll(levels)].size();
+        }
+        return n;
+    }
+    int stealable() const
+    { // the front of the highest priority queue is kept for this CPU
+        return max(this->load() - 1, 0);
+    }
+    int steal()
+    { // from the tail of the lowest priority non-empty queue
+        int level = 63 - __builtin_clzll(this->ready_levels);
+        int handle = this->ready_queues[level].pop_back();
+        if (this->ready_queues[level].empty())
+        {
+            this->ready_levels &= ~(1ULL << level);
+        }
+        this->sim.processes[handle].priority = level;
+        return handle;
+    }
+    void save(snapshot_t &snap) const
+    {
+        snap.put(this->cur_level);
+        for (size_t i = 0; i < this->ready_queues.size(); i++)
+        {
+            snap.put_queue(this->ready_queues[i]);
+        }
+    }
+    void restore(snapshot_t &snap)
+    {
+        this->cur_level = snap.get_int(-1, this->ready_queues.size() - 1);
+        for (size_t i = 0; i < this->ready_queues.size(); i++)
+        {
+            snap.get_queue(this->ready_queues[i], this->sim.processes.size());
+            if (!this->ready_queues[i].empty())
+            {
+                this->ready_levels |= 1ULL << i;
+            }
+        }
+        // aging and boosts go on from the first tick due at or after the snapshot
+        int tick = this->sim.cur_tick;
+        if (this->sim.params.fb_aging > 0)
+        {
+            this->next_aging = max((tick + this->sim.params.fb_aging - 1) / this->sim.params.fb_aging * this->sim.params.fb_aging, this->sim.params.fb_aging);
+        }
+        if (this->sim.params.fb_boost > 0)
+        {
+            this->next_boost = max((tick + this->sim.params.fb_boost - 1) / this->sim.params.fb_boost * this->sim.params.fb_boost, this->sim.params.fb_boost);
+        }
+    }
+};
+
+// Binary min-heap of process handles ordered by key, equal keys in insertion order
+struct process_heap_t
+{
+    struct entry_t
+    {
+        long long key;
+        long long seq;
+        int handle;
+        bool operator>(const entry_t &other) const
+        {
+            return this->key != other.key ? this->key > other.key : this->seq > other.seq;
+        }
+    };
+    vector<entry_t> entries;
+    long long next_seq;
+    process_heap_t() : next_seq(0) {}
+
+    bool empty() const
+    {
+        return this->entries.empty();
+    }
+    int size() const
+    {
+        return this->entries.size();
+    }
+    int top() const
+    {
+        return this->entries.front().handle;
+    }
+    long long top_key() const
+    {
+        return this->entries.front().key;
+    }
+    void push(int handle, long long key)
+    {
+        entry_t entry = {key, this->next_seq++, handle};
+        this->entries.push_back(entry);
+        push_heap(this->entries.begin(), this->entries.end(), greater<entry_t>());
+    }
+    int pop()
+    {
+        pop_heap(this->entries.begin(), this->entries.end(), greater<entry_t>());
+        int handle = this->entries.back().handle;
+        this->entries.pop_back();
+        return handle;
+    }
+    // Remove the last entry, a leaf, so the heap order holds without sifting
+    int pop_last()
+    {
+        int handle = this->entries.back().handle;
+        this->entries.pop_back();
+        return handle;
+    }
+    void save(snapshot_t &snap) const
+    { // in heap order, restored as is
+        snap.put(this->next_seq);
+        snap.put(this->entries.size());
+        for (size_t i = 0; i < this->entries.size(); i++)
+        {
+            snap.put(this->entries[i].key);
+            snap.put(this->entries[i].seq);
+            snap.put(this->entries[i].handle);
+        }
+    }
+    void restore(snapshot_t &snap, int handle_num)
+    {
+        this->next_seq = snap.get();
+        this->entries.resize(snap.get_int(0, handle_num));
+        for (size_t i = 0; i < this->entries.size(); i++)
+        {
+            this->entries[i].key = snap.get();
+            this->entries[i].seq = snap.get();
+            this->entries[i].handle = snap.get_int(0, handle_num - 1);
+        }
+    }
+};
+
+// Shortest Process Next: non-preemptive, the ready process with the shortest next CPU burst runs first
+struct spn_policy_t
+{
+    sim_state_t &sim;
+    process_heap_t ready_heap; // keyed by the length of the next CPU burst
+    int running;               // selected process, kept out of the heap until it leaves the CPU
+    spn_policy_t(sim_state_t &sim) : sim(sim), running(-1) {}
+
+    void on_arrival(int handle)
+    {
+        this->ready_heap.push(handle, this->sim.remaining_ticks(handle));
+    }
+    void on_unblock(int handle)
+    {
+        this->ready_heap.push(handle, this->sim.remaining_ticks(handle));
+    }
+    int select_next()
+    {
+        if (this->running < 0 && !this->ready_heap.empty())
+        {
+            this->running = this->ready_heap.pop();
+        }
+        return this->running;
+    }
+    void on_leave()
+    {
+        this->running = -1;
+    }
+    void on_preempt() {}
+    int quantum() const
+    {
+        return NO_EVENT;
+    }
+    bool should_preempt() const
+    {
+        return false;
+    }
+    int quiet_ticks() const
+    {
+        return NO_EVENT;
+    }
+    int peek(int &quantum) const
+    {
+        quantum = NO_EVENT;
+        if (this->running >= 0)
+        {
+            return this->running;
+        }
+        return this->ready_heap.empty() ? -1 : DISPATCH_PENDING;
+    }
+    int load() const
+    {
+        return this->ready_heap.size() + (this->running >= 0);
+    }
+    int stealable() const
+    {
+        return this->ready_heap.size();
+    }
+    int steal()
+    {
+        return this->ready_heap.pop_last();
+    }
+    void save(snapshot_t &snap) const
+    {
+        snap.put(this->running);
+        this->ready_heap.save(snap);
+    }
+    void restore(snapshot_t &snap)
+    {
+        this->running = snap.get_int(-1, (long long)this->sim.processes.size() - 1);
+        this->ready_heap.restore(snap, this->sim.processes.size());
+    }
+};
+
+// Shortest Remaining Time: preemptive SPN, a process that becomes ready with a shorter burst than what
+// is left of the running one takes over the CPU
+struct srt_policy_t : spn_policy_t
+{
+    srt_policy_t(sim_state_t &sim) : spn_policy_t(sim) {}
+
+    void on_preempt()
+    {
+        this->ready_heap.push(this->running, this->sim.remaining_ticks(this->running));
+        this->running = -1;
+    }
+    bool should_preempt() const
+    {
+        return this->running >= 0 && !this->ready_heap.empty() && this->ready_heap.top_key() < this->sim.remaining_ticks(this->running);
+    }
+    int peek(int &quantum) const
+    { // keys in the heap are fixed and the running process only gets shorter, so if no preemption is due
+      // now, none is before the next arrival or unblock
+        quantum = NO_EVENT;
+        if (this->should_preempt())
+        {
+            return DISPATCH_PENDING;
+        }
+        return spn_policy_t::peek(quantum);
+    }
+};
+
+// Highest Response Ratio Next: non-preemptive, picks the ready process with the highest
+// (time waiting + next CPU burst) / next CPU burst. Waiting processes' ratios grow at different rates,
+// so no single heap order holds over time; but among processes with the same burst the one ready first
+// always wins, so ready processes are kept in one FIFO per burst length and selection only compares
+// the fronts of these FIFOs
+struct hrrn_policy_t
+{
+    struct ready_entry_t
+    {
+        long long seq;  // order the process became ready, the earliest wins ties
+        int handle;
+        int ready_tick; // tick the process became ready
+    };
+    sim_state_t &sim;
+    map<int, deque<ready_entry_t>> ready_groups; // burst length -> ready processes in the order they became ready
+    long long next_seq;
+    int ready_num; // processes in ready_groups
+    int running;
+    hrrn_policy_t(sim_state_t &sim) : sim(sim), next_seq(0), ready_num(0), running(-1) {}
+
+    void on_arrival(int handle)
+    {
+        ready_entry_t entry = {this->next_seq++, handle, this->sim.cur_tick};
+        this->ready_groups[max(this->sim.remaining_ticks(handle), 1)].push_back(entry);
+        this->ready_num++;
+    }
+    void on_unblock(int handle)
+    {
+        this->on_arrival(handle);
+    }
+    int select_next()
+    {
+        if (this->running < 0 && !this->ready_groups.empty())
+        {
+            map<int, deque<ready_entry_t>>::iterator best = this->ready_groups.end();
+            long long best_wait = 0, best_burst = 1, best_seq = 0;
+            for (map<int, deque<ready_entry_t>>::iterator it = this->ready_groups.begin(); it != this->ready_groups.end(); ++it)
+            { // compare (wait + burst) / burst by cross-multiplying
+                const ready_entry_t &entry = it->second.front();
+                long long wait = this->sim.cur_tick - entry.ready_tick;
+                long long burst = it->first;
+                long long lhs = (wait + burst) * best_burst, rhs = (best_wait + best_burst) * burst;
+                if (best == this->ready_groups.end() || lhs > rhs || (lhs == rhs && entry.seq < best_seq))
+                {
+                    best = it;
+                    best_wait = wait;
+                    best_burst = burst;
+                    best_seq = entry.seq;
+                }
+            }
+            this->running = best->second.front().handle;
+            best->second.pop_front();
+            this->ready_num--;
+            if (best->second.empty())
+            {
+                this->ready_groups.erase(best);
+            }
+        }
+        return this->running;
+    }
+    void on_leave()
+    {
+        this->running = -1;
+    }
+    void on_preempt() {}
+    int quantum() const
+    {
+        return NO_EVENT;
+    }
+    bool should_preempt() const
+    {
+        return false;
+    }
+    int quiet_ticks() const
+    {
+        return NO_EVENT;
+    }
+    int peek(int &quantum) const
+    {
+        quantum = NO_EVENT;
+        if (this->running >= 0)
+        {
+            return this->running;
+        }
+        return this->ready_groups.empty() ? -1 : DISPATCH_PENDING;
+    }
+    int load() const
+    {
+        return this->ready_num + (this->running >= 0);
+    }
+    int stealable() const
+    {
+        return this->ready_num;
+    }
+    int steal()
+    { // the process that became ready last among those with the longest burst
+        map<int, deque<ready_entry_t>>::iterator last = --this->ready_groups.end();
+        int handle = last->second.back().handle;
+        last->second.pop_back();
+        if (last->second.empty())
+        {
+            this->ready_groups.erase(last);
+        }
+        this->ready_num--;
+        return handle;
+    }
+    void save(snapshot_t &snap) const
+    {
+        snap.put(this->next_seq);
+        snap.put(this->running);
+        snap.put(this->ready_groups.size());
+        for (map<int, deque<ready_entry_t>>::const_iterator it = this->ready_groups.begin(); it != this->ready_groups.end(); ++it)
+        {
+            snap.put(it->first);
+            snap.put(it->second.size());
+            for (size_t i = 0; i < it->second.size(); i++)
+            {
+                snap.put(it->second[i].seq);
+                snap.put(it->second[i].handle);
+                snap.put(it->second[i].ready_tick);
+            }
+        }
+    }
+    void restore(snapshot_t &snap)
+    {
+        int handle_num = this->sim.processes.size();
+        this->next_seq = snap.get();
+        this->running = snap.get_int(-1, handle_num - 1);
+        for (int groups = snap.get_int(0, handle_num); groups > 0; groups--)
+        {
+            deque<ready_entry_t> &group = this->ready_groups[snap.get_int(1, INT_MAX)];
+            for (int n = snap.get_int(1, handle_num); n > 0; n--)
+            {
+                ready_entry_t entry;
+                entry.seq = snap.get();
+                entry.handle = snap.get_int(0, handle_num - 1);
+                entry.ready_tick = snap.get();
+                group.push_back(entry);
+                this->ready_num++;
+            }
+        }
+    }
+};
+
+#define CFS_VRUNTIME_SCALE (1LL << 30) // virtual runtime a process of weight 1 gains in one tick
+
+// Completely Fair Scheduler: every process gets a share of the CPU in proportion to its weight. Running t
+// ticks adds t * CFS_VRUNTIME_SCALE / weight to the virtual runtime of a process, and the ready process
+// with the least virtual runtime runs next. Ready processes are kept in a red-black tree ordered by it, so
+// admitting one and picking the next are O(log n) however many are ready. The running process keeps the CPU
+// for params.min_granularity ticks, then until its virtual runtime passes that of the first ready one; a
+// process that becomes ready does not preempt it. `min_vruntime` never goes down and a process that arrives
+// or comes back from a block starts no lower, so time spent away is no credit to catch up with
+struct cfs_policy_t
+{
+    struct entry_t
+    {
+        long long vruntime;
+        long long seq; // order the process became ready, the earliest wins ties
+        int handle;
+        bool operator<(const entry_t &other) const
+        {
+            return this->vruntime != other.vruntime ? this->vruntime < other.vruntime : this->seq < other.seq;
+        }
+    };
+    sim_state_t &sim;
+    set<entry_t> ready_tree;
+    long long next_seq;
+    long long min_vruntime; // least virtual runtime of this run queue so far
+    int running;            // selected process, kept out of the tree until it leaves the CPU
+    int start_tick;         // tick the running process was selected
+    cfs_policy_t(sim_state_t &sim) : sim(sim), next_seq(0), min_vruntime(0), running(-1), start_tick(0) {}
+
+    void enqueue(int handle)
+    {
+        process_t &p = this->sim.processes[handle];
+        p.vruntime = max(p.vruntime, this->min_vruntime);
+        entry_t entry = {p.vruntime, this->next_seq++, handle};
+        this->ready_tree.insert(entry);
+    }
+    // Add the ticks the running process ran, up to the end of the current tick, to its virtual runtime
+    void charge()
+    {
+        process_t &p = this->sim.processes[this->running];
+        p.vruntime += (long long)(this->sim.cur_tick + 1 - this->start_tick) * CFS_VRUNTIME_SCALE / p.weight;
+        this->running = -1;
+    }
+    void on_arrival(int handle)
+    {
+        this->enqueue(handle);
+    }
+    void on_unblock(int handle)
+    {
+        this->enqueue(handle);
+    }
+    int select_next()
+    {
+        if (this->running < 0 && !this->ready_tree.empty())
+        { // the leftmost process has the least virtual runtime of the run queue
+            entry_t first = *this->ready_tree.begin();
+            this->ready_tree.erase(this->ready_tree.begin());
+            this->running = first.handle;
+            this->start_tick = this->sim.cur_tick;
+            this->min_vruntime = max(this->min_vruntime, first.vruntime);
+        }
+        return this->running;
+    }
+    void on_leave()
+    {
+        this->charge();
+    }
+    void on_preempt()
+    {
+        int handle = this->running;
+        this->charge();
+        this->enqueue(handle);
+    }
+    int quantum() const
+    { // ticks it takes the running process to get more virtual runtime than the first ready one, counted
+      // from when the CPU dispatched it: before start_tick if it continued its working interval after a 0 tick block
+        if (this->running < 0 || this->ready_tree.empty())
+        {
+            return NO_EVENT;
+        }
+        const process_t &p = this->sim.processes[this->running];
+        long long lead = max(this->ready_tree.begin()->vruntime - p.vruntime + 1, 0LL);
+        long long ticks = lead / CFS_VRUNTIME_SCALE * p.weight + (lead % CFS_VRUNTIME_SCALE * p.weight + CFS_VRUNTIME_SCALE - 1) / CFS_VRUNTIME_SCALE;
+        ticks = max(ticks, (long long)this->sim.params.min_granularity) + this->start_tick - this->sim.cpus[p.cpu].dispatched_tick;
+        return ticks >= INT_MAX / 2 ? NO_EVENT : (int)ticks;
+    }
+    bool should_preempt() const
+    {
+        return false;
+    }
+    int quiet_ticks() const
+    {
+        return NO_EVENT;
+    }
+    int peek(int &quantum) const
+    {
+        quantum = this->quantum();
+        if (this->running >= 0)
+        {
+            return this->running;
+        }
+        return this->ready_tree.empty() ? -1 : DISPATCH_PENDING;
+    }
+    int load() const
+    {
+        return this->ready_tree.size() + (this->running >= 0);
+    }
+    int stealable() const
+    {
+        return this->ready_tree.size();
+    }
+    int steal()
+    { // the process with the most virtual runtime
+        set<entry_t>::iterator last = --this->ready_tree.end();
+        int handle = last->handle;
+        this->ready_tree.erase(last);
+        return handle;
+    }
+    void save(snapshot_t &snap) const
+    {
+        snap.put(this->next_seq);
+        snap.put(this->min_vruntime);
+        snap.put(this->running);
+        snap.put(this->start_tick);
+        snap.put(this->ready_tree.size());
+        for (set<entry_t>::const_iterator it = this->ready_tree.begin(); it != this->ready_tree.end(); ++it)
+        {
+            snap.put(it->vruntime);
+            snap.put(it->seq);
+            snap.put(it->handle);
+        }
+    }
+    void restore(snapshot_t &snap)
+    {
+        int handle_num = this->sim.processes.size();
+        this->next_seq = snap.get();
+        this->min_vruntime = snap.get();
+        this->running = snap.get_int(-1, handle_num - 1);
+        this->start_tick = snap.get();
+        for (int n = snap.get_int(0, handle_num); n > 0; n--)
+        { // saved in order
+            entry_t entry;
+            entry.vruntime = snap.get();
+            entry.seq = snap.get();
+            entry.handle = snap.get_int(0, handle_num - 1);
+            this->ready_tree.insert(this->ready_tree.end(), entry);
+        }
+    }
+};
+
+// `policy_t` with the event trace compiled in: policy_run_t is instantiated once more for it, so a run that
+// is not traced does not even test whether it is
+template <class policy_t>
+struct traced_t : policy_t
+{
+    traced_t(sim_state_t &sim) : policy_t(sim) {}
+};
+
+template <class policy_t>
+struct is_traced<traced_t<policy_t> >
+{
+    static const bool value = true;
+};
+
+// I/O device scheduling: every busy device provides service to the first process in its block queue and
+// hands it back to the run queue of its CPU once its I/O is completed. The devices whose I/O completes
+// come from the timing wheel, no other device is visited. Only called in a tick where some I/O completes
+template <class policy_t>
+void device_scheduling(sim_state_t &sim, vector<policy_t> &policies)
+{
+    vector<int> &done = sim.devices_done;
+    done.clear();
+    sim.device_wheel.advance(sim.cur_tick, done);
+    if (done.size() > 1)
+    { // completions of the same tick are handled in device id order
+        sort(done.begin(), done.end());
+    }
+    for (size_t i = 0; i < done.size(); i++)
+    { // I/O service is completed
+        int device = done[i];
+        ring_queue_t &block_queue = sim.device_queues[device];
+        int handle = block_queue.pop_front();
+        process_t &cur_io_process = sim.processes[handle];
+        cur_io_process.proceed_to_next_service();
+        sim.device_metrics[device].add(sim.cur_tick - cur_io_process.queued_tick);
+        cur_io_process.queued_tick = sim.cur_tick;
+        policies[cur_io_process.cpu].on_unblock(handle);
+        sim.trace_event<policy_t, TRACE_UNBLOCK_DEVICE>(cur_io_process.cpu, handle, device);
+        if (!block_queue.empty())
+        { // the process now at the front starts its service in this tick, its I/O is done after at least this one
+            sim.device_wheel.add(device, sim.due_tick(sim.cur_tick, max(sim.cost(sim.cur_service(block_queue.front())), 1)));
+        }
+    }
+}
+
+// Mutex scheduling: the first process waiting for a mutex that was unlocked gets it, in mutex id order
+// Only the mutexes unlocked since the last call are visited, the call is skipped when there are none
+template <class policy_t>
+void mutex_scheduling(sim_state_t &sim, vector<policy_t> &policies)
+{
+    sort(sim.released_mutexes.begin(), sim.released_mutexes.end());
+    sim.released_mutexes.erase(unique(sim.released_mutexes.begin(), sim.released_mutexes.end()), sim.released_mutexes.end());
+    for (size_t i = 0; i < sim.released_mutexes.size(); i++)
+    {
+        int mutex = sim.released_mutexes[i];
+        ring_queue_t &block_queue = sim.mutex_queues[mutex];
+        if (sim.mutexes[mutex].status_lock == false && !block_queue.empty())
+        { // lock the mutex if it was not locked again by the process that unlocked it
+            sim.mutexes[mutex].myMutex_lock();
+            int handle = block_queue.pop_front();
+            process_t &p = sim.processes[handle];
+            p.proceed_to_next_service();
+            sim.mutex_metrics[mutex].add(sim.cur_tick - p.queued_tick);
+            p.queued_tick = sim.cur_tick;
+            policies[p.cpu].on_unblock(handle);
+            sim.trace_event<policy_t, TRACE_UNBLOCK_MUTEX>(p.cpu, handle, mutex);
+        }
+    }
+    sim.released_mutexes.clear();
+}
+
+// CPU with the fewest processes in its run queue, the lowest id on ties
+template <class policy_t>
+int least_loaded_cpu(const vector<policy_t> &policies)
+{
+    int best = 0;
+    for (int cpu = 1; cpu < (int)policies.size(); cpu++)
+    {
+        if (policies[cpu].load() < policies[best].load())
+        {
+            best = cpu;
+        }
+    }
+    return best;
+}
+
+// CPU an idle `thief` takes work from under the steal policy, -1 if no CPU has a process to spare
+template <class policy_t>
+int steal_victim(const sim_state_t &sim, const vector<policy_t> &policies, int thief)
+{
+    int cpu_num = policies.size();
+    if (sim.params.steal == STEAL_NEIGHBOR)
+    {
+        for (int i = 1; i < cpu_num; i++)
+        {
+            if (policies[(thief + i) % cpu_num].stealable() > 0)
+            {
+                return (thief + i) % cpu_num;
+            }
+        }
+        return -1;
+    }
+    int victim = -1, most = 0;
+    for (int cpu = 0; cpu < cpu_num; cpu++)
+    {
+        if (policies[cpu].stealable() > most)
+        {
+            victim = cpu;
+            most = policies[cpu].stealable();
+        }
+    }
+    return victim;
+}
+
+// Idle CPUs take ready processes from the run queues of the other CPUs, in CPU id order
+template <class policy_t>
+void steal_work(sim_state_t &sim, vector<policy_t> &policies)
+{
+    if (sim.params.steal == STEAL_NONE)
+    {
+        return;
+    }
+    vector<int> stolen;
+    for (int thief = 0; thief < (int)policies.size(); thief++)
+    {
+        if (policies[thief].load() != 0)
+        {
+            continue;
+        }
+        int victim = steal_victim(sim, policies, thief);
+        if (victim < 0)
+        {
+            continue;
+        }
+        int count = sim.params.steal == STEAL_HALF ? (policies[victim].stealable() + 1) / 2 : 1;
+        stolen.clear();
+        for (int i = 0; i < count; i++)
+        {
+            stolen.push_back(policies[victim].steal());
+        }
+        for (int i = count - 1; i >= 0; i--)
+        { // keep the order they had in the victim's run queue
+            sim.processes[stolen[i]].cpu = thief;
+            policies[thief].on_unblock(stolen[i]);
+            sim.trace_event<policy_t, TRACE_MIGRATE>(thief, stolen[i], thief);
+        }
+    }
+}
+
+// Whether an idle CPU would take work from another one in the next tick
+template <class policy_t>
+bool steal_pending(const sim_state_t &sim, const vector<policy_t> &policies)
+{
+    if (sim.params.steal == STEAL_NONE)
+    {
+        return false;
+    }
+    bool idle = false, spare = false;
+    for (size_t cpu = 0; cpu < policies.size(); cpu++)
+    {
+        idle = idle || policies[cpu].load() == 0;
+        spare = spare || policies[cpu].stealable() > 0;
+    }
+    return idle && spare;
+}
+
+// Called when the running process completed its current service: look for its next service, block it for
+// I/O or a locked mutex, complete it, or execute mutex operations right away and keep looking
+template <class policy_t>
+void manage_next_service(sim_state_t &sim, policy_t &policy, int cpu, int handle, bool &logged_working)
+{
+    process_t &cur_process = sim.processes[handle];
+    PROFILE_COUNT(sim, manage_calls);
+    while (true)
+    {
+        PROFILE_COUNT(sim, manage_services);
+        bool process_completed = cur_process.proceed_to_next_service();
+        ring_queue_t *block_queue = NULL;
+        int device = -1;
+        if (process_completed)
+        { // the whole process is completed
+            sim.complete_num++;
+            block_queue = &sim.processes_done;
+            sim.trace_event<policy_t, TRACE_COMPLETE>(cpu, handle, cpu);
+        }
+        else
+        {
+            const service_t &next_service = cur_process.cur_service(sim.services);
+            if (next_service.type == SERVICE_D || next_service.type == SERVICE_K)
+            { // next service is I/O, block current process
+                device = next_service.resource;
+            }
+            else if (next_service.type == SERVICE_L)
+            { // next service is mutex lock
+                Mutex &mutex = sim.mutexes[next_service.resource];
+                if (mutex.status_lock == false)
+                {
+                    mutex.myMutex_lock();
+                    sim.trace_event<policy_t, TRACE_LOCK>(cpu, handle, next_service.resource);
+                    continue; // look for next service
+                }
+                block_queue = &sim.mutex_queues[next_service.resource]; // block current process
+                sim.trace_event<policy_t, TRACE_BLOCK_MUTEX>(cpu, handle, next_service.resource);
+            }
+            else if (next_service.type == SERVICE_U && sim.mutexes[next_service.resource].status_lock == true)
+            { // next service is mutex unlock
+                sim.mutexes[next_service.resource].myMutex_unlock();
+                sim.trace_event<policy_t, TRACE_UNLOCK>(cpu, handle, next_service.resource);
+                if (!sim.mutex_queues[next_service.resource].empty())
+                { // hand the mutex to its first waiter next tick
+                    sim.released_mutexes.push_back(next_service.resource);
+                }
+                continue; // look for next service
+            }
+        }
+        if (block_queue != NULL || device >= 0)
+        { // remove current process from ready queue
+            sim.log_working(handle, sim.cpus[cpu].dispatched_tick, sim.cur_tick + 1, cpu);
+            logged_working = true;
+            policy.on_leave();
+            if (sim.cpus.size() > 1)
+            { // another CPU may hand it a mutex in the next tick, it starts a new working interval then
+              // (a single CPU keeps the original log, where a process back from a 0 tick I/O continues its interval)
+                sim.cpus[cpu].prev_process_id = -1;
+            }
+            if (device >= 0)
+            {
+                sim.block_on_device(device, handle);
+                sim.trace_event<policy_t, TRACE_BLOCK_DEVICE>(cpu, handle, device);
+            }
+            else
+            {
+                block_queue->push_back(handle);
+            }
+        }
+        return;
+    }
+}
+
+// Preempt the running process of `cpu` if it used up its time quantum
+template <class policy_t>
+TICK_INLINE void clock_interrupt(sim_state_t &sim, policy_t &policy, int cpu, int handle)
+{
+    cpu_state_t &state = sim.cpus[cpu];
+    if (sim.cur_tick + 1 - state.dispatched_tick >= policy.quantum())
+    { // Clock interrupt
+        sim.log_working(handle, state.dispatched_tick, sim.cur_tick + 1, cpu);
+        int level = sim.processes[handle].priority;
+        policy.on_preempt();
+        state.prev_process_id = -1; // reset the previous dispatched process ID to empty
+        sim.trace_preempt<policy_t>(cpu, handle, level, sim.cur_tick);
+    }
+}
+
+// The part of a tick that only touches `cpu`, its run queue and its running process: dispatch, run for one
+// tick, clock interrupt. Whatever follows the completion of a service may touch the devices, mutexes and
+// other CPUs' processes and is left to finish_service()
+// This and the helpers it calls every tick are forced inline: left to itself the compiler keeps them out of
+// line, which costs up to 20% on workloads that are mostly clock interrupts, and more once they record the trace
+template <class policy_t>
+TICK_INLINE void cpu_tick(sim_state_t &sim, policy_t &policy, int cpu)
+{
+    cpu_state_t &state = sim.cpus[cpu];
+    state.service_done = false;
+    int handle = policy.select_next();
+    if (handle >= 0 && sim.processes[handle].process_id == state.prev_process_id && policy.should_preempt())
+    { // a process that became ready takes over the CPU
+        sim.log_working(handle, state.dispatched_tick, sim.cur_tick, cpu);
+        int level = sim.processes[handle].priority;
+        policy.on_preempt();
+        state.prev_process_id = -1;
+        sim.trace_preempt<policy_t>(cpu, handle, level, sim.cur_tick - 1);
+        handle = policy.select_next();
+    }
+    if (handle < 0)
+    {                               // no process for scheduling
+        state.prev_process_id = -1; // reset the previous dispatched process ID to empty
+        return;
+    }
+    process_t &cur_process = sim.processes[handle];
+    int cur_process_id = cur_process.process_id;
+    if (cur_process_id != state.prev_process_id)
+    { // store the tick when current process is dispatched
+        state.dispatched_tick = sim.cur_tick;
+        sim.log_dispatch(handle, cpu);
+        sim.trace_event<policy_t, TRACE_DISPATCH>(cpu, handle, cpu);
+    }
+    else if (is_traced<policy_t>::value && state.traced_process_id != cur_process_id)
+    { // back from a 0 tick I/O or mutex wait on a single CPU, the process continues its working interval
+        sim.trace_event<policy_t, TRACE_DISPATCH>(cpu, handle, cpu);
+    }
+    cur_process.cur_service_tick++;         // increment the num of ticks that have been spent on current service
+    state.busy_ticks++;
+    cur_process.queued_tick = sim.cur_tick + 1; // back in a queue from the next tick unless it keeps running
+    state.prev_process_id = cur_process_id; // log the previous dispatched process ID
+    if (cur_process.cur_service_tick >= sim.cost(cur_process.cur_service(sim.services)))
+    { // current service is completed
+        state.running = handle;
+        state.service_done = true;
+        return;
+    }
+    clock_interrupt(sim, policy, cpu, handle);
+}
+
+// Rest of the tick of a CPU whose running process completed its service
+template <class policy_t>
+void finish_service(sim_state_t &sim, policy_t &policy, int cpu)
+{
+    bool logged_working = false; // flag to track if log_working() already occured
+    int handle = sim.cpus[cpu].running;
+    manage_next_service(sim, policy, cpu, handle, logged_working); // look for next service
+    if (!logged_working)
+    {
+        clock_interrupt(sim, policy, cpu, handle);
+    }
+}
+
+// Host threads that run cpu_tick() for disjoint ranges of CPUs. The calling thread takes the first range,
+// the others spin (yielding) between ticks, so this only pays off with many CPUs per host thread
+struct tick_workers_t
+{
+    int thread_num;
+    int cpu_num;
+    function<void(int, int)> step; // run the CPUs [begin, end)
+    atomic<int> epoch;             // bumped once per tick
+    atomic<int> finished;          // worker threads done with the current tick
+    atomic<bool> stopping;
+    vector<thread> threads;
+
+    tick_workers_t(int thread_num, int cpu_num, function<void(int, int)> step)
+        : thread_num(max(1, min(thread_num, cpu_num))), cpu_num(cpu_num), step(step), epoch(0), finished(0), stopping(false)
+    {
+        for (int t = 1; t < this->thread_num; t++)
+        {
+            this->threads.push_back(thread(&tick_workers_t::work, this, t));
+        }
+    }
+    ~tick_workers_t()
+    {
+        this->stopping.store(true);
+        for (size_t t = 0; t < this->threads.size(); t++)
+        {
+            this->threads[t].join();
+        }
+    }
+    int range_begin(int t) const
+    {
+        return (long long)this->cpu_num * t / this->thread_num;
+    }
+    void work(int t)
+    {
+        int seen = 0;
+        while (true)
+        {
+            while (this->epoch.load(memory_order_acquire) == seen)
+            {
+                if (this->stopping.load())
+                {
+                    return;
+                }
+                this_thread::yield();
+            }
+            seen++;
+            this->step(this->range_begin(t), this->range_begin(t + 1));
+            this->finished.fetch_add(1, memory_order_release);
+        }
+    }
+    // Run one tick on all CPUs, returns once every range is done
+    void run()
+    {
+        this->finished.store(0, memory_order_relaxed);
+        this->epoch.fetch_add(1, memory_order_release);
+        this->step(0, this->range_begin(1));
+        while (this->finished.load(memory_order_acquire) < this->thread_num - 1)
+        {
+            this_thread::yield();
+        }
+    }
+};
+
+// Admit a process arriving at the current tick, it joins the run queue of the least loaded CPU
+template <class policy_t>
+void admit_process(sim_state_t &sim, vector<policy_t> &policies, int handle)
+{
+    int cpu = least_loaded_cpu(policies);
+    sim.processes[handle].cpu = cpu;
+    sim.processes[handle].queued_tick = sim.cur_tick;
+    policies[cpu].on_arrival(handle);
+    sim.trace_event<policy_t, TRACE_ARRIVAL>(cpu, handle, cpu);
+}
+
+// Long term scheduler: admit the processes arriving at the current tick, in order of arrival then ID
+template <class policy_t>
+void admit_arrivals(sim_state_t &sim, vector<policy_t> &policies)
+{
+    if (sim.source)
+    {
+        while (sim.source->next_arrival() <= sim.cur_tick)
+        {
+            admit_process(sim, policies, sim.generate_process());
+        }
+        return;
+    }
+    vector<process_t> &processes = sim.processes;
+    while (sim.next_arrival_idx < (int)processes.size() && processes[sim.next_arrival_idx].arrival_time <= sim.cur_tick)
+    {
+        if (processes[sim.next_arrival_idx].arrival_time == sim.cur_tick)
+        {
+            admit_process(sim, policies, sim.next_arrival_idx);
+        }
+        sim.next_arrival_idx++; // a process with a negative arrival time is never admitted
+    }
+}
+
+// Number of ticks before the next process arrival
+int arrival_quiet_ticks(const sim_state_t &sim)
+{
+    if (sim.source)
+    {
+        int next_arrival = sim.source->next_arrival();
+        return next_arrival == NO_EVENT ? NO_EVENT : next_arrival - sim.cur_tick - 1;
+    }
+    if (sim.next_arrival_idx >= (int)sim.processes.size())
+    {
+        return NO_EVENT;
+    }
+    return sim.processes[sim.next_arrival_idx].arrival_time - sim.cur_tick - 1;
+}
+
+// Number of ticks the busy devices can serve the fronts of their block queues before an I/O completes
+int device_quiet_ticks(const sim_state_t &sim)
+{
+    int first = sim.device_wheel.first;
+    return first == NO_EVENT ? NO_EVENT : max(first - sim.cur_tick - 1, 0);
+}
+
+// Number of ticks the mutex block queues stay unchanged (they only move when a mutex is unlocked)
+int mutex_quiet_ticks(const sim_state_t &sim)
+{
+    return sim.released_mutexes.empty() ? NO_EVENT : 0;
+}
+
+// Number of ticks the process `handle` keeps running on `cpu` without finishing its service or using up
+// `quantum`. Returns 0 when the next tick dispatches a different process
+inline int cpu_quiet_ticks(const sim_state_t &sim, int cpu, int handle, int quantum)
+{
+    if (handle == -1)
+    {
+        return NO_EVENT;
+    }
+    const cpu_state_t &state = sim.cpus[cpu];
+    if (handle == DISPATCH_PENDING || sim.processes[handle].process_id != state.prev_process_id)
+    {
+        return 0;
+    }
+    int gap = sim.remaining_ticks(handle) - 1;
+    if (quantum != NO_EVENT)
+    {
+        gap = (int)min((long long)gap, (long long)state.dispatched_tick + quantum - 2 - sim.cur_tick);
+    }
+    return max(gap, 0);
+}
+
+// Jump over `gap` ticks in which no arrival, I/O completion, mutex hand-off, dispatch, service completion,
+// clock interrupt or work stealing can happen: the only effect of such ticks is the progress of the
+// running processes, devices keep the tick their I/O completes. `next_handles` holds what every CPU runs next
+void skip_quiet_ticks(sim_state_t &sim, const vector<int> &next_handles, int gap)
+{
+    for (size_t cpu = 0; cpu < sim.cpus.size(); cpu++)
+    {
+        if (next_handles[cpu] < 0)
+        { // CPU stays idle
+            sim.cpus[cpu].prev_process_id = -1;
+        }
+        else
+        {
+            sim.processes[next_handles[cpu]].cur_service_tick += gap;
+            sim.processes[next_handles[cpu]].queued_tick += gap;
+            sim.cpus[cpu].busy_ticks += gap;
+        }
+    }
+    sim.cur_tick += gap;
+}
+
+unsigned long long workload_fingerprint(const workload_t &workload)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    auto mix = [&hash](long long value)
+    {
+        hash = (hash ^ (unsigned long long)value) * 1099511628211ULL;
+    };
+    auto mix_names = [&mix](const vector<string> &names)
+    {
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            for (size_t c = 0; c <= names[i].size(); c++)
+            {
+                mix(names[i].c_str()[c]);
+            }
+        }
+    };
+    auto mix_dist = [&mix](const distribution_t &dist)
+    {
+        long long mean_bits, sd_bits;
+        memcpy(&mean_bits, &dist.mean, sizeof(mean_bits));
+        memcpy(&sd_bits, &dist.sd, sizeof(sd_bits));
+        mix(dist.kind);
+        mix(dist.lo);
+        mix(dist.hi);
+        mix(mean_bits);
+        mix(sd_bits);
+    };
+    mix_names(workload.resources.device_names);
+    mix_names(workload.resources.mutex_names);
+    if (workload.synthetic)
+    {
+        const synthetic_spec_t &spec = workload.spec;
+        const distribution_t *dists[] = {&spec.arrival, &spec.burst, &spec.io};
+        for (int i = 0; i < 3; i++)
+        {
+            mix_dist(*dists[i]);
+        }
+        mix(spec.processes);
+        mix(spec.cpu_weight);
+        mix(spec.io_weight);
+        mix(spec.mutex_weight);
+        mix(spec.auto_arrival);
+        mix(spec.mutexes);
+        mix(spec.nested);
+        mix(spec.seed);
+        return hash;
+    }
+    for (size_t i = 0; i < workload.processes.size(); i++)
+    {
+        mix(workload.processes[i].process_id);
+        mix(workload.processes[i].arrival_time);
+        mix(workload.processes[i].service_num);
+        mix(workload.processes[i].weight);
+    }
+    for (size_t i = 0; i < workload.services.size(); i++)
+    {
+        mix(workload.services[i].type);
+        mix(workload.services[i].time_cost);
+        mix(workload.services[i].resource);
+        if (workload.services[i].draw >= 0)
+        {
+            mix(workload.services[i].draw);
+        }
+    }
+    for (size_t i = 0; i < workload.cost_dists.size(); i++)
+    {
+        mix_dist(workload.cost_dists[i]);
+    }
+    return hash;
+}
+
+// Writes the snapshots of a run: every params.checkpoint_every seconds and once at tick params.checkpoint_at
+struct checkpointer_t
+{
+    const sched_params_t &params;
+    bool enabled;
+    snapshot_header_t header;
+    chrono::steady_clock::time_point next_time;
+    int countdown; // main loop iterations before the clock is read again
+    bool at_done;
+    checkpointer_t(const sched_params_t &params)
+        : params(params), enabled(!params.checkpoint_path.empty()),
+          next_time(chrono::steady_clock::now() + chrono::seconds(params.checkpoint_every)), countdown(1), at_done(false) {}
+
+    bool due(int cur_tick)
+    {
+        if (this->params.checkpoint_at >= 0 && cur_tick >= this->params.checkpoint_at && !this->at_done)
+        {
+            this->at_done = true;
+            return true;
+        }
+        if (--this->countdown > 0)
+        {
+            return false;
+        }
+        this->countdown = 1024;
+        return chrono::steady_clock::now() >= this->next_time;
+    }
+    // Quiet ticks after `cur_tick` that can be skipped without going past the --checkpoint-at tick
+    int skippable(int cur_tick) const
+    {
+        if (!this->enabled || this->params.checkpoint_at < 0 || this->at_done || cur_tick >= this->params.checkpoint_at)
+        {
+            return NO_EVENT;
+        }
+        return this->params.checkpoint_at - cur_tick - 1;
+    }
+};
+
+// Snapshot the run at the start of the current tick. The output log is flushed to disk first, the
+// snapshot records how far it goes
+template <class policy_t>
+void save_checkpoint(checkpointer_t &checkpoints, const sim_state_t &sim, const vector<policy_t> &policies, const run_summary_t &summary,
+                     output_writer_t &output)
+{
+    output.flush();
+    if (output.fd >= 0)
+    {
+        fsync(output.fd);
+    }
+    checkpoints.header.output_offset = output.flushed;
+    snapshot_t snap;
+    snap.put(SNAPSHOT_VERSION);
+    checkpoints.header.save(snap);
+    sim.save(snap);
+    summary.save(snap);
+    for (size_t cpu = 0; cpu < policies.size(); cpu++)
+    {
+        policies[cpu].save(snap);
+    }
+    if (!snap.write(checkpoints.params.checkpoint_path))
+    {
+        cerr << "Cannot write " << checkpoints.params.checkpoint_path << endl;
+    }
+    checkpoints.next_time = chrono::steady_clock::now() + chrono::seconds(checkpoints.params.checkpoint_every);
+}
+
+#ifdef SCHED_PROFILE
+// Raise the high-water marks of --profile to the current run and mutex queue lengths, device queues are
+// measured as processes join them
+template <class policy_t>
+void profile_queues(sim_state_t &sim, const vector<policy_t> &policies)
+{
+    profiler_t &profile = *sim.profile;
+    for (size_t cpu = 0; cpu < policies.size(); cpu++)
+    {
+        profile.raise(profile.ready_max, cpu, policies[cpu].load());
+    }
+    for (size_t mutex = 0; mutex < sim.mutex_queues.size(); mutex++)
+    {
+        profile.raise(profile.mutex_max, mutex, sim.mutex_queues[mutex].size());
+    }
+    profile.done_max = max(profile.done_max, sim.processes_done.size());
+}
+#endif
+
+void collect_metrics(const sim_state_t &sim, run_summary_t &summary)
+{
+    for (size_t cpu = 0; cpu < sim.cpus.size(); cpu++)
+    {
+        const cpu_state_t &state = sim.cpus[cpu];
+        summary.busy_ticks += state.busy_ticks;
+        summary.cpu_busy_ticks.push_back(state.busy_ticks);
+        for (size_t level = 0; level < state.ready_queues.size(); level++)
+        {
+            if (level == 0 || state.ready_queues[level].entries > 0)
+            {
+                summary.queues.push_back(make_pair("ready cpu" + to_string(cpu) + " RQ" + to_string(level), state.ready_queues[level]));
+            }
+        }
+    }
+    for (size_t device = 0; device < sim.device_metrics.size(); device++)
+    {
+        if (sim.device_metrics[device].entries > 0)
+        {
+            summary.queues.push_back(make_pair("device " + sim.resources.device_names[device], sim.device_metrics[device]));
+        }
+    }
+    for (size_t mutex = 0; mutex < sim.mutex_metrics.size(); mutex++)
+    {
+        if (sim.mutex_metrics[mutex].entries > 0)
+        {
+            summary.queues.push_back(make_pair("mutex " + sim.resources.mutex_names[mutex], sim.mutex_metrics[mutex]));
+        }
+    }
+}
+
+// Simulation core shared by all scheduling policies, `policies` holds the run queue of every CPU
+template <class policy_t>
+struct policy_run_t : sim_run_t
+{
+    string algorithm;
+    const workload_t &workload;
+    output_writer_t &output;
+    vector<policy_t> policies;
+    checkpointer_t checkpoints;
+    trace_writer_t trace;
+    lod_builder_t lod;
+#ifdef SCHED_PROFILE
+    profiler_t profile;
+#endif
+    tick_workers_t workers;
+    vector<int> next_handles; // what every CPU runs next, looked up to skip quiet ticks
+    bool started;
+
+    policy_run_t(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output)
+        : sim_run_t(workload, params, output.format == OUTPUT_TEXT || output.format == OUTPUT_BINARY || !params.lod_path.empty()),
+          algorithm(algorithm), workload(workload), output(output), policies(params.cpus, policy_t(this->sim)), checkpoints(params),
+#ifdef SCHED_PROFILE
+          profile(params.cpus, workload.resources.device_names.size(), workload.resources.mutex_names.size()),
+#endif
+          workers(params.sim_threads, params.cpus, [this](int begin, int end)
+                  {
+                      for (int cpu = begin; cpu < end; cpu++)
+                      {
+                          cpu_tick(this->sim, this->policies[cpu], cpu);
+                      }
+                  }),
+          next_handles(params.cpus), started(false)
+    {
+        this->summary.cpus = params.cpus;
+    }
+
+    bool start(snapshot_t *resume)
+    {
+        const sched_params_t &params = this->sim.params;
+#ifndef SCHED_PROFILE
+        if (params.profile)
+        { // the layout of sched_params_t does not depend on the build, only the profiler does
+            cerr << "Profiling needs a build with -DSCHED_PROFILE" << endl;
+            this->summary.failed = true;
+            return false;
+        }
+#endif
+        if (this->checkpoints.enabled)
+        {
+            this->checkpoints.header = snapshot_header_t(this->algorithm, this->workload, params, this->output);
+        }
+        if (resume != NULL)
+        {
+            bool restored = this->sim.restore(*resume);
+            this->summary.restore(*resume);
+            for (int cpu = 0; cpu < params.cpus && restored; cpu++)
+            {
+                this->policies[cpu].restore(*resume);
+            }
+            if (!restored || resume->failed || resume->pos != resume->data.size())
+            {
+                cerr << "The snapshot is corrupt" << endl;
+                this->summary.failed = true;
+                return false;
+            }
+        }
+        if (is_traced<policy_t>::value)
+        {
+            if (!this->trace.open(params.trace_path.c_str(), this->workload.resources, params.cpus))
+            {
+                cerr << "Cannot open " << params.trace_path << endl;
+                this->summary.failed = true;
+                return false;
+            }
+            this->trace.threaded = this->workers.thread_num > 1;
+            this->sim.trace = &this->trace;
+        }
+        if (!params.lod_path.empty())
+        {
+            this->sim.lod = &this->lod;
+            for (size_t handle = 0; handle < this->sim.processes.size(); handle++)
+            {
+                const process_t &p = this->sim.processes[handle];
+                if (p.process_id >= 0 && p.cur_service_idx < p.service_num)
+                {
+                    this->lod.expect(p.process_id);
+                }
+            }
+        }
+#ifdef SCHED_PROFILE
+        if (params.profile)
+        {
+            this->sim.profile = &this->profile;
+        }
+#endif
+        this->started = true;
+        return true;
+    }
+
+    bool run_until(int limit)
+    {
+        sim_state_t &sim = this->sim;
+        vector<policy_t> &policies = this->policies;
+        vector<process_t> &processes = sim.processes;
+        int cpu_num = policies.size();
+
+        // main loop
+        PROFILE_START(sim);
+        for (; sim.cur_tick < limit; sim.cur_tick++)
+        {
+            PROFILE_COUNT(sim, iterations);
+            if (this->checkpoints.enabled && this->checkpoints.due(sim.cur_tick))
+            {
+                save_checkpoint(this->checkpoints, sim, policies, this->summary, this->output);
+                PROFILE_LAP(sim, PROFILE_CHECKPOINT);
+            }
+            int cur_tick = sim.cur_tick;
+
+            // long term scheduler
+            admit_arrivals(sim, policies);
+            PROFILE_LAP(sim, PROFILE_ADMIT);
+
+            // I/O device scheduling, the default disk first and the keyboard second. Most ticks complete no
+            // I/O and unlock no mutex, they do not even make the call
+            if (cur_tick >= sim.device_wheel.first)
+            {
+                device_scheduling(sim, policies);
+            }
+            PROFILE_LAP(sim, PROFILE_DEVICES);
+            // mutex scheduling
+            if (!sim.released_mutexes.empty())
+            {
+                mutex_scheduling(sim, policies);
+            }
+            PROFILE_LAP(sim, PROFILE_MUTEXES);
+            // idle CPUs take work from busy ones
+            if (cpu_num > 1)
+            {
+                steal_work(sim, policies);
+                PROFILE_LAP(sim, PROFILE_STEAL);
+            }
+            PROFILE_QUEUES(sim, policies);
+            // CPU scheduling: every CPU runs its process for one tick, then the completed services are looked
+            // at in CPU id order as they may block on shared devices and mutexes
+            if (this->workers.thread_num == 1)
+            {
+                for (int cpu = 0; cpu < cpu_num; cpu++)
+                {
+                    cpu_tick(sim, policies[cpu], cpu);
+                }
+            }
+            else
+            {
+                this->workers.run();
+                if (is_traced<policy_t>::value)
+                { // the blocks the CPUs filled, which they could not write out at the same time
+                    sim.trace->flush_full();
+                }
+            }
+            PROFILE_LAP(sim, PROFILE_CPUS);
+            for (int cpu = 0; cpu < cpu_num; cpu++)
+            {
+                if (sim.cpus[cpu].service_done)
+                {
+                    finish_service(sim, policies[cpu], cpu);
+                }
+            }
+            PROFILE_LAP(sim, PROFILE_SERVICES);
+            PROFILE_QUEUES(sim, policies);
+            if (sim.source)
+            { // the pool entries of the completed processes are free once they are written
+                for (int i = 0; i < sim.processes_done.size(); i++)
+                {
+                    sim.free_handles.push_back(sim.processes_done.at(i));
+                }
+            }
+            if (sim.lod != NULL)
+            {
+                for (int i = 0; i < sim.processes_done.size(); i++)
+                {
+                    sim.lod->add(processes[sim.processes_done.at(i)], sim.working, sim.processes_done.at(i));
+                }
+            }
+            write_done_processes(processes, sim.services, sim.drawn_costs, sim.processes_done, sim.working, cur_tick + 1, this->output, this->summary); // write output
+            PROFILE_LAP(sim, PROFILE_OUTPUT);
+            if (sim.complete_num == sim.total_processes)
+            { // all process completed
+                sim.cur_tick++;
+                return false;
+            }
+            // jump straight to the next tick where something can happen, at most to `limit`
+            int gap = min({arrival_quiet_ticks(sim), mutex_quiet_ticks(sim), device_quiet_ticks(sim)});
+            for (int cpu = 0; cpu < cpu_num; cpu++)
+            {
+                int quantum = NO_EVENT;
+                this->next_handles[cpu] = policies[cpu].peek(quantum);
+                gap = min({gap, cpu_quiet_ticks(sim, cpu, this->next_handles[cpu], quantum), policies[cpu].quiet_ticks()});
+            }
+            if (gap > 0 && cpu_num > 1 && steal_pending(sim, policies))
+            {
+                gap = 0;
+            }
+            if (gap == NO_EVENT)
+            { // no process can make progress any more
+                sim.cur_tick++;
+                return false;
+            }
+            gap = min({gap, limit - cur_tick - 1, this->checkpoints.skippable(cur_tick)});
+            if ((long long)cur_tick + gap + 1 > MAX_TICK)
+            { // ticks are ints, the event ticks past MAX_TICK were clamped
+                cerr << "The run goes past tick " << MAX_TICK << ", the last one that can be simulated" << endl;
+                this->summary.failed = true;
+                return false;
+            }
+            if (gap > 0)
+            {
+                skip_quiet_ticks(sim, this->next_handles, gap);
+            }
+            PROFILE_LAP(sim, PROFILE_SKIP);
+        }
+        return true;
+    }
+
+    void finish()
+    {
+        if (!this->started)
+        {
+            return;
+        }
+        const sched_params_t &params = this->sim.params;
+#ifdef SCHED_PROFILE
+        if (params.profile)
+        {
+            this->profile.report(this->sim.resources, this->sim.cur_tick);
+        }
+#endif
+        if (is_traced<policy_t>::value && !this->trace.close())
+        {
+            cerr << "Cannot write " << params.trace_path << endl;
+            this->summary.failed = true;
+        }
+        if (this->sim.lod != NULL && !this->lod.write(params.lod_path.c_str()))
+        {
+            cerr << "Cannot write " << params.lod_path << endl;
+            this->summary.failed = true;
+        }
+        collect_metrics(this->sim, this->summary);
+        if (this->output.format == OUTPUT_METRICS)
+        {
+            write_metrics_report(this->output, this->summary);
+        }
+    }
+
+    int load(int cpu) const
+    {
+        return this->policies[cpu].load();
+    }
+};
+
+bool is_algorithm(const string &algorithm)
+{
+    return algorithm == "FCFS" || algorithm == "RR" || algorithm == "FB" || algorithm == "SPN" || algorithm == "SRT" || algorithm == "HRRN" ||
+           algorithm == "CFS";
+}
+
+sim_run_t *new_run(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output)
+{
+    bool traced = !params.trace_path.empty();
+    if (algorithm == "RR")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<rr_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<rr_policy_t>(algorithm, workload, params, output);
+    }
+    else if (algorithm == "FB")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<fb_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<fb_policy_t>(algorithm, workload, params, output);
+    }
+    else if (algorithm == "SPN")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<spn_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<spn_policy_t>(algorithm, workload, params, output);
+    }
+    else if (algorithm == "SRT")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<srt_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<srt_policy_t>(algorithm, workload, params, output);
+    }
+    else if (algorithm == "HRRN")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<hrrn_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<hrrn_policy_t>(algorithm, workload, params, output);
+    }
+    else if (algorithm == "CFS")
+    {
+        return traced ? (sim_run_t *)new policy_run_t<traced_t<cfs_policy_t> >(algorithm, workload, params, output)
+                      : new policy_run_t<cfs_policy_t>(algorithm, workload, params, output);
+    }
+    return traced ? (sim_run_t *)new policy_run_t<traced_t<fcfs_policy_t> >(algorithm, workload, params, output)
+                  : new policy_run_t<fcfs_policy_t>(algorithm, workload, params, output);
+}
+
+simulator_t::simulator_t()
+    : own_workload(new workload_t()), own_output(new output_writer_t()), idle(false), finished(false)
+{
+    this->workload = this->own_workload.get();
+    this->output = this->own_output.get();
+}
+
+simulator_t::~simulator_t()
+{
+    if (this->sim_run)
+    {
+        this->finish();
+    }
+}
+
+bool simulator_t::open(const string &algorithm, const sched_params_t &params, const char *output_path, int format)
+{
+    if (!is_algorithm(algorithm))
+    {
+        cerr << "Unknown algorithm " << algorithm << endl;
+        return false;
+    }
+    if (!this->own_output->open(output_path, format))
+    {
+        cerr << "Cannot open " << this->own_output->path << endl;
+        return false;
+    }
+    return this->open(algorithm, *this->own_workload, params, *this->own_output);
+}
+
+bool simulator_t::open(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output,
+                       snapshot_t *resume)
+{
+    this->workload = &workload;
+    this->params = params;
+    this->output = &output;
+    this->sim_run.reset(new_run(algorithm, workload, this->params, output));
+    return this->sim_run->start(resume);
+}
+
+bool simulator_t::add_process(int process_id, int arrival_time, const vector<string> &services)
+{
+    if (!this->sim_run || this->workload != this->own_workload.get())
+    {
+        cerr << "Processes can only be added to a run opened without a workload" << endl;
+        return false;
+    }
+    sim_state_t &sim = this->sim_run->sim;
+    if (arrival_time < sim.cur_tick)
+    {
+        cerr << "Process " << process_id << " arrives at tick " << arrival_time << ", before the current tick " << sim.cur_tick << endl;
+        return false;
+    }
+    string text = "# " + to_string(process_id) + " " + to_string(arrival_time) + " " + to_string(services.size()) + "\n";
+    for (size_t i = 0; i < services.size(); i++)
+    {
+        text += services[i] + "\n";
+    }
+    input_cursor_t in = {text.data(), text.data() + text.size(), 1};
+    string name = "process " + to_string(process_id);
+    workload_t &own = *this->own_workload;
+    size_t service_num = own.services.size();
+    vector<process_t> added;
+    if (!parse_processes(in, name.c_str(), added, own.services, own.resources) || added.size() != 1)
+    {
+        if (added.size() > 1)
+        {
+            cerr << name << ": a service line holds another process" << endl;
+        }
+        own.services.resize(service_num);
+        return false;
+    }
+    sim.add_resources();
+    // processes are sorted by arrival then ID, the ones not admitted yet can still move
+    vector<process_t> &processes = sim.processes;
+    size_t index = upper_bound(processes.begin() + sim.next_arrival_idx, processes.end(), added[0], arrives_before) - processes.begin();
+    processes.insert(processes.begin() + index, added[0]);
+    if (sim.keep_working)
+    {
+        sim.working.lists.insert(sim.working.lists.begin() + index, working_log_t::list_t());
+    }
+    sim.total_processes++;
+    this->idle = false;
+    return true;
+}
+
+bool simulator_t::run_until(int tick)
+{
+    sim_state_t &sim = this->sim_run->sim;
+    if (!this->idle && !this->finished)
+    {
+        this->idle = !this->sim_run->run_until(tick);
+    }
+    if (this->idle && tick > sim.cur_tick)
+    {
+        for (size_t cpu = 0; cpu < sim.cpus.size(); cpu++)
+        {
+            sim.cpus[cpu].prev_process_id = -1;
+        }
+        sim.cur_tick = tick;
+    }
+    return !this->idle;
+}
+
+void simulator_t::run()
+{
+    if (!this->idle && !this->finished)
+    {
+        this->idle = !this->sim_run->run_until(INT_MAX);
+    }
+}
+
+const run_summary_t &simulator_t::finish()
+{
+    if (this->sim_run && !this->finished)
+    {
+        this->finished = true;
+        this->sim_run->finish();
+        if (this->output == this->own_output.get() && !this->own_output->close())
+        {
+            cerr << "Cannot write the output" << endl;
+            this->sim_run->summary.failed = true;
+        }
+    }
+    return this->sim_run->summary;
+}
+
+int simulator_t::tick() const
+{
+    return this->sim_run->sim.cur_tick;
+}
+
+int simulator_t::completed() const
+{
+    return this->sim_run->sim.complete_num;
+}
+
+int simulator_t::process_count() const
+{
+    return this->sim_run->sim.processes.size();
+}
+
+const process_t &simulator_t::process(int index) const
+{
+    return this->sim_run->sim.processes[index];
+}
+
+int simulator_t::find_process(int process_id) const
+{
+    const vector<process_t> &processes = this->sim_run->sim.processes;
+    for (size_t i = 0; i < processes.size(); i++)
+    {
+        if (processes[i].process_id == process_id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int simulator_t::status(int index) const
+{
+    const sim_state_t &sim = this->sim_run->sim;
+    const process_t &p = sim.processes[index];
+    if (p.cur_service_idx >= p.service_num)
+    {
+        return PROCESS_DONE;
+    }
+    if ((!sim.source && index >= sim.next_arrival_idx) || p.arrival_time < 0)
+    {
+        return PROCESS_PENDING;
+    }
+    const service_t &service = p.cur_service(sim.services);
+    const ring_queue_t *queue = service.type == SERVICE_D || service.type == SERVICE_K ? &sim.device_queues[service.resource]
+                                : service.type == SERVICE_L                             ? &sim.mutex_queues[service.resource]
+                                                                                        : NULL;
+    for (int i = 0; queue != NULL && i < queue->size(); i++)
+    {
+        if (queue->at(i) == index)
+        {
+            return PROCESS_BLOCKED;
+        }
+    }
+    return sim.cpus[p.cpu].prev_process_id == p.process_id ? PROCESS_RUNNING : PROCESS_READY;
+}
+
+int simulator_t::load(int cpu) const
+{
+    return this->sim_run->load(cpu);
+}
+
+int simulator_t::device_waiting(int device) const
+{
+    return this->sim_run->sim.device_queues[device].size();
+}
+
+int simulator_t::mutex_waiting(int mutex) const
+{
+    return this->sim_run->sim.mutex_queues[mutex].size();
+}
+
+const resource_table_t &simulator_t::resources() const
+{
+    return this->sim_run->sim.resources;
+}
+
+run_summary_t simulator_t::metrics() const
+{
+    run_summary_t summary = this->sim_run->summary;
+    if (!this->finished)
+    {
+        collect_metrics(this->sim_run->sim, summary);
+    }
+    return summary;
+}
+
+run_summary_t run_algorithm(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output,
+                            snapshot_t *resume)
+{
+    simulator_t simulator;
+    if (simulator.open(algorithm, workload, params, output, resume))
+    {
+        simulator.run();
+    }
+    return simulator.finish();
+}
+
+bool parse_int_list(const string &s, vector<int> &values, const string &delim)
+{
+    vector<string> tokens;
+    split(s, tokens, delim);
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        char *end;
+        long value = strtol(tokens[i].c_str(), &end, 10);
+        if (*end != '\0' || value <= 0 || value > INT_MAX)
+        {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+bool parse_steal_policy(const string &name, vector<int> &values)
+{
+    const char *names[] = {"none", "busiest", "neighbor", "half"}; // indexed by steal_policy_t
+    for (int i = 0; i < 4; i++)
+    {
+        if (name == names[i])
+        {
+            values.push_back(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_mix(const string &text, synthetic_spec_t &spec)
+{
+    vector<string> tokens;
+    split(text, tokens, ":");
+    long weights[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        char *end;
+        weights[i] = i < tokens.size() ? strtol(tokens[i].c_str(), &end, 10) : -1;
+        if (i >= tokens.size() || *end != '\0' || weights[i] < 0 || weights[i] > 1000000)
+        {
+            return false;
+        }
+    }
+    spec.cpu_weight = weights[0];
+    spec.io_weight = weights[1];
+    spec.mutex_weight = weights[2];
+    return tokens.size() == 3 && weights[0] + weights[1] + weights[2] > 0;
+}
+
+bool parse_synthetic_spec(const string &text, synthetic_spec_t &spec)
+{
+    vector<string> options;
+    split(text, options, ",");
+    for (size_t i = 0; i < options.size(); i++)
+    {
+        size_t eq = options[i].find('=');
+        string key = options[i].substr(0, eq);
+        string value = eq == string::npos ? "" : options[i].substr(eq + 1);
+        vector<int> values;
+        bool ok = true;
+        if (key == "n" && parse_int_list(value, values, ","))
+        {
+            spec.processes = values[0];
+        }
+        else if (key == "mix")
+        {
+            ok = parse_mix(value, spec);
+        }
+        else if (key == "arrival")
+        {
+            spec.auto_arrival = value == "auto";
+            ok = spec.auto_arrival || spec.arrival.parse(value);
+        }
+        else if (key == "burst" || key == "io")
+        {
+            distribution_t &dist = key == "burst" ? spec.burst : spec.io;
+            ok = dist.parse(value) && (dist.kind >= DIST_EXP || dist.lo > 0); // services of 0 ticks are not generated
+        }
+        else if (key == "mutexes" && parse_int_list(value, values, ","))
+        {
+            spec.mutexes = values[0];
+        }
+        else if (key == "sections" && (value == "single" || value == "nested"))
+        {
+            spec.nested = value == "nested";
+        }
+        else if (key == "seed" && !value.empty())
+        {
+            spec.seed = strtoull(value.c_str(), NULL, 10);
+        }
+        else
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            cerr << "Wrong synthetic workload option " << options[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool load_workload(const char *path, workload_t &workload)
+{
+    if (strncmp(path, SYNTHETIC_PREFIX, strlen(SYNTHETIC_PREFIX)) == 0)
+    {
+        workload.synthetic = true;
+        if (!parse_synthetic_spec(path + strlen(SYNTHETIC_PREFIX), workload.spec))
+        {
+            return false;
+        }
+        for (int i = 0; i < workload.spec.mutexes; i++)
+        { // mutex ids follow the order of first use, like in a process file written from the source
+            workload.resources.mutex_id("m" + to_string(i));
+        }
+        return true;
+    }
+    return load_processes(path, workload.processes, workload.services, workload.resources, &workload.cost_dists);
+}
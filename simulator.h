@@ -0,0 +1,222 @@
+// Process scheduling simulator: the parameters, the summary and the simulator_t that drives a run. The
+// workload and output formats, the scheduling policies and the helpers shared with the command line tool
+// are internal to the library, in simulator_internal.h
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct process_t;
+struct process_metrics_t;
+struct service_t;
+struct resource_table_t;
+struct snapshot_t;
+struct workload_t;
+struct output_writer_t;
+struct sim_run_t;
+
+// How an idle CPU takes work from the run queues of the other CPUs
+enum steal_policy_t
+{
+    STEAL_NONE,     // never, a process stays on the CPU it was placed on
+    STEAL_BUSIEST,  // one process from the CPU with the most waiting processes
+    STEAL_NEIGHBOR, // one process from the next CPU (in id order, wrapping around) that has a waiting one
+    STEAL_HALF      // half of the waiting processes of the busiest CPU
+};
+
+// Scheduling parameters that can be set at runtime
+struct sched_params_t
+{
+    int quantum;                // RR time quantum, also used by every FB level unless fb_quanta is given
+    int fb_levels;              // number of FB ready queues
+    std::vector<int> fb_quanta; // explicit time quantum of every FB level, RQ0 first
+    int fb_aging;               // ticks between two moves of every FB level below RQ0 up by one, 0 for none
+    int fb_boost;               // ticks between two moves of every ready FB process to RQ0, 0 for none
+    int min_granularity;        // ticks a CFS process runs before one with less virtual runtime can take over
+    long long mem_limit;        // bytes of working intervals kept in memory before the longest logs spill to a file, 0 for no limit
+    unsigned long long seed;    // draws the stochastic service costs of the run
+    int cpus;                   // number of simulated CPUs, each with its own run queue
+    int steal;                  // steal_policy_t
+    int sim_threads;            // host threads running the per-CPU part of a tick
+    std::string checkpoint_path; // snapshot written while the run goes, none if empty
+    int checkpoint_every;        // seconds between two snapshots
+    int checkpoint_at;           // tick of one more snapshot, -1 for none
+    std::string trace_path;      // event trace of the run, none if empty
+    std::string lod_path;        // level-of-detail pyramid of the working intervals, none if empty
+    bool profile;                // time the phases of the simulation loop, only in a build with -DSCHED_PROFILE
+    sched_params_t(); // the defaults of the command line tool
+
+    int levels() const
+    {
+        return this->fb_quanta.empty() ? this->fb_levels : this->fb_quanta.size();
+    }
+    int level_quantum(int level) const
+    {
+        return this->fb_quanta.empty() ? this->quantum : this->fb_quanta[level];
+    }
+};
+
+// Output log formats
+enum output_format_t
+{
+    OUTPUT_TEXT,  // two lines per process: "process <id>" and its working sequence, plus "cpu <id> ..." with more than one CPU
+    OUTPUT_BINARY, // "SCHB" then per process: zigzag varints of the ID, the working sequence length and each working tick as a delta
+                   // A negative length means the CPU id of every working interval follows
+    OUTPUT_DISCARD, // nothing is written, for runs that only need the summary metrics
+    OUTPUT_METRICS  // a CSV line of metrics per process and a report of the run, working sequences are never stored
+};
+
+// Latency histogram with fixed buckets, the percentiles it reports are at most 1/16 above the exact ones:
+// latencies below 16 are counted exactly, larger ones in 16 sub-buckets per power of two
+struct latency_histogram_t
+{
+    std::vector<long long> buckets;
+    long long count;
+    long long max_value;
+    latency_histogram_t();
+
+    static int bucket_of(long long value);
+    // Largest value counted in `bucket`
+    static long long bucket_max(int bucket);
+    void add(long long value);
+    // Smallest bucket bound that at least `fraction` of the values are not above
+    long long percentile(double fraction) const;
+    void save(snapshot_t &snap) const;
+    void restore(snapshot_t &snap);
+};
+
+// Waiting statistics of one queue: the ticks from entering it to leaving it, a ready queue is left on
+// dispatch, a block queue when the I/O completes or the mutex is handed over
+struct queue_metrics_t
+{
+    long long entries;
+    long long total_wait;
+    long long max_wait;
+    queue_metrics_t() : entries(0), total_wait(0), max_wait(0) {}
+
+    void add(long long wait)
+    {
+        this->entries++;
+        this->total_wait += wait;
+        this->max_wait = this->max_wait > wait ? this->max_wait : wait;
+    }
+    void save(snapshot_t &snap) const;
+    void restore(snapshot_t &snap);
+};
+
+// Summary metrics of one run, accumulated as processes complete
+struct run_summary_t
+{
+    long long completed;
+    long long makespan;      // tick the last process completed
+    long long busy_ticks;    // ticks the CPUs spent running processes, set when the run ends
+    double total_turnaround; // sum of completion - arrival
+    double total_waiting;    // sum of turnaround - requested service time
+    double total_response;   // sum of first dispatch - arrival
+    int cpus;                // number of simulated CPUs
+    bool failed;             // the run could not be restored from a snapshot
+    latency_histogram_t turnaround;
+    latency_histogram_t waiting;
+    latency_histogram_t response;
+    std::vector<long long> cpu_busy_ticks;                          // per CPU, set when the run ends
+    std::vector<std::pair<std::string, queue_metrics_t> > queues; // every ready and block queue that was used, set when the run ends
+    run_summary_t() : completed(0), makespan(0), busy_ticks(0), total_turnaround(0), total_waiting(0), total_response(0), cpus(1), failed(false) {}
+
+    // `drawn_costs` are the stochastic service costs of the run, see service_t::draw
+    process_metrics_t add(const process_t &p, const std::vector<service_t> &services, const std::vector<int> &drawn_costs, long long completion_tick);
+    double average(double total) const
+    {
+        return this->completed == 0 ? 0 : total / this->completed;
+    }
+    // Only what is accumulated while the run goes, the rest is set when it ends
+    void save(snapshot_t &snap) const;
+    void restore(snapshot_t &snap);
+    double cpu_utilisation() const
+    {
+        return this->makespan == 0 ? 0 : (double)this->busy_ticks / this->makespan / this->cpus;
+    }
+    double throughput() const
+    {
+        return this->makespan == 0 ? 0 : (double)this->completed / this->makespan;
+    }
+};
+
+// Where a process stands, as seen between two ticks
+enum process_status_t
+{
+    PROCESS_PENDING, // not arrived yet
+    PROCESS_READY,   // in a run queue
+    PROCESS_RUNNING, // ran in the last tick and keeps its CPU
+    PROCESS_BLOCKED, // in the block queue of an I/O device or a mutex
+    PROCESS_DONE
+};
+
+// Simulation run driven from outside: it is opened empty and fed with add_process() while it goes, or
+// opened over a parsed workload, then advanced by step(), run_until() or run(), its state looked at in
+// between. Instances share no state, any number of them can run at once on different threads. The run
+// refers to the members, so a simulator is neither copied nor moved
+struct simulator_t
+{
+    std::unique_ptr<workload_t> own_workload; // resource names and services of the added processes
+    const workload_t *workload;
+    sched_params_t params;
+    std::unique_ptr<output_writer_t> own_output;
+    output_writer_t *output;
+    std::unique_ptr<sim_run_t> sim_run;
+    bool idle;     // no process can make progress until more are added
+    bool finished;
+
+    simulator_t();
+    simulator_t(const simulator_t &) = delete;
+    simulator_t &operator=(const simulator_t &) = delete;
+    ~simulator_t();
+
+    // Start an empty run of `algorithm`, written to `output_path` in `format` (an output_format_t)
+    bool open(const std::string &algorithm, const sched_params_t &params, const char *output_path = NULL, int format = OUTPUT_DISCARD);
+    // Start a run of `algorithm` (FCFS unless RR, FB, SPN, SRT, HRRN or CFS) over `workload` written to `output`,
+    // both owned by the caller; `resume` is a snapshot read up to its state, the run continues from there
+    bool open(const std::string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output,
+              snapshot_t *resume = NULL);
+
+    // Add a process arriving at `arrival_time`, no earlier than tick(), with `services` in the format of
+    // the input file ("C 3", "D disk2 4", "L mtx"...). Only runs opened empty take new processes
+    bool add_process(int process_id, int arrival_time, const std::vector<std::string> &services);
+
+    // Simulate the ticks before `tick`, returns false when no process can make progress any more. An idle
+    // run jumps straight to `tick`, new processes can arrive from there
+    bool run_until(int tick);
+    bool step()
+    {
+        return this->run_until(this->tick() + 1);
+    }
+    // Simulate until no process can make progress any more
+    void run();
+
+    // End the run: write the trace, the LOD pyramid and the metrics report, close an output opened by
+    // open(). No tick can be simulated afterwards
+    const run_summary_t &finish();
+
+    int tick() const; // next tick to simulate
+    int completed() const;
+    // Processes are indexed in order of arrival then ID. With a synthetic or streamed workload these are the entries of
+    // the process pool instead, reused once their process completes
+    int process_count() const;
+    const process_t &process(int index) const;
+    // Index of the process `process_id`, -1 if there is none. Adding a process moves the ones that arrive
+    // after it
+    int find_process(int process_id) const;
+    // process_status_t of the process at `index`
+    int status(int index) const;
+    int load(int cpu) const;              // processes in the run queue of `cpu`, the running one included
+    int device_waiting(int device) const; // processes in the block queue of an I/O device, the serviced one included
+    int mutex_waiting(int mutex) const;
+    const resource_table_t &resources() const;
+    // Summary of the run so far, with the metrics of the CPUs and queues
+    run_summary_t metrics() const;
+};
+
+#endif
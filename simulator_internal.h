@@ -0,0 +1,2519 @@
+// Internals of the process scheduling simulator: the workload and output formats, the scheduling policies
+// behind simulator_t and the helpers shared with the command line tool in scheduler.cpp. Only
+// simulator.cpp and scheduler.cpp include this, a program embedding the simulator includes simulator.h
+#ifndef SIMULATOR_INTERNAL_H
+#define SIMULATOR_INTERNAL_H
+
+#include "simulator.h"
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef SCHED_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+using namespace std;
+
+#define DEFAULT_QUANTUM 5 // default time quantum
+#define FB_LEVELS 3       // default number of FB ready queues
+#define FB_MAX_LEVELS 64  // FB ready queues are found through the bits of a 64-bit word
+#define CFS_DEFAULT_WEIGHT 1024 // CFS weight of a process whose header gives none, that of a nice 0 task in Linux
+#define CFS_MAX_WEIGHT 1048576  // largest CFS weight a process file may give
+#define NO_EVENT INT_MAX // gap returned when nothing is scheduled to happen
+#define MAX_TICK (INT_MAX / 2) // last tick a run may simulate, one that would go past it stops with an error
+#define DEVICE_DISK 0     // device of "D <cost>" services
+#define DEVICE_KEYBOARD 1 // device of "K <cost>" services
+#define TICK_INLINE inline __attribute__((always_inline)) // helpers of the tick loop, inlined whatever their size
+
+// myMutex structure
+struct Mutex
+{
+    bool status_lock; //true-lock   false-unlock
+    Mutex() : status_lock(false) {}
+    Mutex(bool status_)
+    {
+        this->status_lock = status_;
+    }
+    void myMutex_lock()
+    {
+        if (status_lock == false)
+        {
+            status_lock = true;
+        }
+    }
+    void myMutex_unlock()
+    {
+        if (status_lock == true)
+        {
+            status_lock = false;
+        }
+    }
+};
+
+// Service opcodes
+enum service_type_t
+{
+    SERVICE_C, // CPU
+    SERVICE_K, // keyboard input
+    SERVICE_D, // disk I/O
+    SERVICE_L, // mutex lock
+    SERVICE_U  // mutex unlock
+};
+
+// Names of the I/O devices and mutexes of a workload, interned to the ids services refer to
+struct resource_table_t
+{
+    vector<string> device_names; // device id -> name
+    vector<string> mutex_names;  // mutex id -> name
+    map<string, int> device_ids;
+    map<string, int> mutex_ids;
+    resource_table_t()
+    {
+        this->device_id("disk");     // DEVICE_DISK
+        this->device_id("keyboard"); // DEVICE_KEYBOARD
+    }
+
+    static int intern(const string &name, vector<string> &names, map<string, int> &ids)
+    {
+        map<string, int>::iterator it = ids.find(name);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        ids[name] = names.size();
+        names.push_back(name);
+        return names.size() - 1;
+    }
+    int device_id(const string &name)
+    {
+        return intern(name, this->device_names, this->device_ids);
+    }
+    int mutex_id(const string &name)
+    {
+        return intern(name, this->mutex_names, this->mutex_ids);
+    }
+};
+
+// Service structure
+// The services of all processes are stored back to back in one shared arena (vector<service_t>)
+struct service_t
+{
+    unsigned char type; // service_type_t
+    int time_cost;
+    int resource; // device id of K and D, mutex id of L and U
+    int draw;     // index of a stochastic cost among the ones drawn per run (workload_t::cost_dists), -1 for a fixed one
+    service_t() : type(SERVICE_C), time_cost(-1), resource(0), draw(-1) {}
+    // `tokens` is one service line split on blanks: "C 3", "K 3", "D 3", "D disk2 3", "L mtx" or "U mtx"
+    service_t(const vector<string> &tokens, resource_table_t &resources) : resource(0), draw(-1)
+    {
+        const string &type = tokens[0];
+        if (type == "L" || type == "U")
+        {
+            this->type = type == "L" ? SERVICE_L : SERVICE_U;
+            this->time_cost = 0;
+            this->resource = resources.mutex_id(tokens[1]);
+        }
+        else
+        { // any other service is only ever run on CPU or an I/O device
+            this->type = type == "D" ? SERVICE_D : type == "K" ? SERVICE_K : SERVICE_C;
+            this->time_cost = stoi(tokens.back());
+            if (this->type != SERVICE_C)
+            {
+                this->resource = tokens.size() > 2 ? resources.device_id(tokens[1]) : this->type == SERVICE_D ? DEVICE_DISK : DEVICE_KEYBOARD;
+            }
+        }
+    }
+};
+
+// Process structure
+struct process_t
+{
+    int process_id;
+    int arrival_time;
+    int service_offset; // index of the first service in the service arena
+    int service_num;
+    int cur_service_idx;
+    int cur_service_tick; // num of ticks that has been spent on current service
+    int priority = 0;     // which priority queue located in ONLY FOR FEEDBACK
+    int cpu = 0;          // CPU whose run queue the process belongs to
+    int first_dispatch_tick = -1;
+    int queued_tick = 0; // tick the process entered its current ready or block queue, the tick after the current one while it runs
+    int weight = CFS_DEFAULT_WEIGHT; // share of the CPU under CFS, from the process header
+    long long vruntime = 0;          // virtual runtime ONLY FOR CFS
+
+    const service_t &cur_service(const vector<service_t> &services) const
+    {
+        return services[this->service_offset + this->cur_service_idx];
+    }
+
+    // Call when current service completed
+    // if there are no service left, return true. Otherwise, return false
+    bool proceed_to_next_service()
+    {
+        this->cur_service_idx++;
+        this->cur_service_tick = 0;
+        // all services are done, process should end; otherwise it still requests services
+        return this->cur_service_idx >= this->service_num;
+    };
+};
+
+// FIFO queue of process handles (indices into the process pool) kept in a ring buffer
+// Every process sits in at most one queue, so a capacity of the number of processes never overflows;
+// queues of single devices and mutexes start small and double when they are full
+struct ring_queue_t
+{
+    vector<int> slots; // size is a power of two
+    unsigned int mask;
+    unsigned int head; // position of the front handle
+    unsigned int count;
+    ring_queue_t(int capacity) : head(0), count(0)
+    {
+        unsigned int size = 1;
+        while (size < (unsigned int)capacity)
+        {
+            size <<= 1;
+        }
+        this->slots.resize(size);
+        this->mask = size - 1;
+    }
+    bool empty() const
+    {
+        return this->count == 0;
+    }
+    int size() const
+    {
+        return this->count;
+    }
+    int front() const
+    {
+        return this->slots[this->head];
+    }
+    // i-th handle counted from the front
+    int at(int i) const
+    {
+        return this->slots[(this->head + i) & this->mask];
+    }
+    void push_back(int handle)
+    {
+        if (this->count == this->slots.size())
+        {
+            this->grow();
+        }
+        this->slots[(this->head + this->count) & this->mask] = handle;
+        this->count++;
+    }
+    void grow()
+    {
+        vector<int> slots(this->slots.size() * 2);
+        for (unsigned int i = 0; i < this->count; i++)
+        {
+            slots[i] = this->at(i);
+        }
+        this->slots.swap(slots);
+        this->mask = this->slots.size() - 1;
+        this->head = 0;
+    }
+    int pop_front()
+    {
+        int handle = this->slots[this->head];
+        this->head = (this->head + 1) & this->mask;
+        this->count--;
+        return handle;
+    }
+    int pop_back()
+    {
+        this->count--;
+        return this->slots[(this->head + this->count) & this->mask];
+    }
+};
+
+// Read a zigzag-encoded varint, fails if the input ends in the middle of it
+bool get_varint(const vector<unsigned char> &data, size_t &pos, long long &value);
+
+#define SNAPSHOT_MAGIC "SCHK"
+#define SNAPSHOT_VERSION 5
+
+// Checkpoint of a simulation run: "SCHK" then zigzag varints, doubles stored as their bit patterns. The
+// same object writes a snapshot (put_*) and reads it back in the same order (get_*); reading past the
+// end or a value out of its range sets `failed`
+struct snapshot_t
+{
+    vector<unsigned char> data;
+    size_t pos;
+    bool failed;
+    snapshot_t() : pos(0), failed(false) {}
+
+    void put(long long value)
+    {
+        unsigned long long v = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+        while (v >= 0x80)
+        {
+            this->data.push_back((unsigned char)(v | 0x80));
+            v >>= 7;
+        }
+        this->data.push_back((unsigned char)v);
+    }
+    long long get()
+    {
+        long long value = 0;
+        if (!this->failed && !get_varint(this->data, this->pos, value))
+        {
+            this->failed = true;
+        }
+        return this->failed ? 0 : value;
+    }
+    // Read a value that has to be in [lo, hi], `lo` once reading failed
+    int get_int(long long lo, long long hi)
+    {
+        long long value = this->get();
+        if (this->failed || value < lo || value > hi)
+        {
+            this->failed = true;
+            return lo;
+        }
+        return value;
+    }
+    void put_double(double value)
+    {
+        long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        this->put(bits);
+    }
+    double get_double()
+    {
+        long long bits = this->get();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    void put_string(const string &text)
+    {
+        this->put(text.size());
+        this->data.insert(this->data.end(), text.begin(), text.end());
+    }
+    string get_string()
+    {
+        size_t n = this->get_int(0, this->data.size() - this->pos);
+        string text(this->data.begin() + this->pos, this->data.begin() + this->pos + n);
+        this->pos += n;
+        return text;
+    }
+    void put_ints(const vector<int> &values)
+    {
+        this->put(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            this->put(values[i]);
+        }
+    }
+    // Read a vector of values in [lo, hi]
+    void get_ints(vector<int> &values, long long lo, long long hi)
+    {
+        values.resize(this->get_int(0, this->data.size() - this->pos));
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = this->get_int(lo, hi);
+        }
+    }
+    void put_queue(const ring_queue_t &queue)
+    {
+        this->put(queue.size());
+        for (int i = 0; i < queue.size(); i++)
+        {
+            this->put(queue.at(i));
+        }
+    }
+    // Read a queue of handles below `handle_num` into an empty queue
+    void get_queue(ring_queue_t &queue, int handle_num)
+    {
+        int n = this->get_int(0, this->data.size() - this->pos);
+        for (int i = 0; i < n; i++)
+        {
+            queue.push_back(this->get_int(0, handle_num - 1));
+        }
+    }
+
+    // Write the snapshot next to `file_path` first, so that a crash while writing keeps the previous one
+    bool write(const string &file_path) const
+    {
+        string temp_path = file_path + ".tmp";
+        int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        bool ok = ::write(fd, SNAPSHOT_MAGIC, 4) == 4;
+        size_t written = 0;
+        while (ok && written < this->data.size())
+        {
+            ssize_t n = ::write(fd, this->data.data() + written, this->data.size() - written);
+            ok = n > 0;
+            written += ok ? n : 0;
+        }
+        ok = fsync(fd) == 0 && ok;
+        ok = ::close(fd) == 0 && ok;
+        return ok && rename(temp_path.c_str(), file_path.c_str()) == 0;
+    }
+    bool read(const string &file_path)
+    {
+        ifstream file(file_path.c_str(), ios::binary);
+        this->data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        this->pos = 4;
+        this->failed = this->data.size() < 4 || memcmp(this->data.data(), SNAPSHOT_MAGIC, 4) != 0;
+        return !this->failed && this->get() == SNAPSHOT_VERSION;
+    }
+};
+
+// Metrics of one completed process
+struct process_metrics_t
+{
+    long long completion_tick;
+    long long turnaround; // completion - arrival
+    long long waiting;    // turnaround - requested service time
+    long long response;   // first dispatch - arrival
+};
+
+#define WORKING_CHUNK_BYTES 60          // log bytes of a chunk, 64 with the link to the next one
+#define WORKING_SPILL_BUFFER (64 << 10) // bytes read from the spill file at once
+
+// Working intervals of every process of a run, by process handle. An interval is stored as zigzag varints
+// of its start minus the end of the one before and of its length, then the CPU when more than one is
+// simulated, in a list of chunks drawn from one arena. Once the chunks in use take more than `mem_limit`
+// bytes, the longest lists are appended to a temporary file until they take half of it: a spilled segment
+// is the file offset of the process's segment before it (-1 for none) in 64 bits, its length in 32 bits
+// and its bytes. Reading a list streams its segments back in order, then its chunks
+struct working_log_t
+{
+    struct chunk_t
+    {
+        int next; // next chunk of the list, -1 for none; next free chunk while free
+        unsigned char bytes[WORKING_CHUNK_BYTES];
+    };
+    struct list_t
+    {
+        int head = -1;
+        int tail = -1;
+        int tail_used = WORKING_CHUNK_BYTES; // bytes used of the tail chunk
+        int chunks = 0;
+        int intervals = 0;
+        int last_tick = 0;   // end of the last interval
+        long long spilled = -1; // file offset of the last spilled segment
+    };
+    vector<chunk_t> arena;
+    int free_chunks; // head of the free list
+    int used_chunks;
+    vector<list_t> lists;
+    vector<int> holders; // handles whose lists may hold chunks, the ones that got their first one since the last spill
+    bool with_cpus;
+    long long mem_limit; // bytes of chunks in use before lists spill, 0 for no limit
+    FILE *spill_file;
+    long long spill_size;
+    bool locked; // appends come from more than one host thread
+    mutex append_lock;
+    working_log_t(int process_num, bool with_cpus, long long mem_limit, bool locked)
+        : free_chunks(-1), used_chunks(0), lists(process_num), with_cpus(with_cpus), mem_limit(mem_limit), spill_file(NULL), spill_size(0),
+          locked(locked) {}
+    ~working_log_t()
+    {
+        if (this->spill_file != NULL)
+        {
+            fclose(this->spill_file);
+        }
+    }
+
+    int take_chunk()
+    {
+        int chunk = this->free_chunks;
+        if (chunk >= 0)
+        {
+            this->free_chunks = this->arena[chunk].next;
+        }
+        else
+        {
+            chunk = this->arena.size();
+            this->arena.push_back(chunk_t());
+        }
+        this->arena[chunk].next = -1;
+        this->used_chunks++;
+        return chunk;
+    }
+    // Give the chunks of `list` back to the arena
+    void free_list(list_t &list)
+    {
+        if (list.head >= 0)
+        {
+            this->arena[list.tail].next = this->free_chunks;
+            this->free_chunks = list.head;
+        }
+        this->used_chunks -= list.chunks;
+        list.head = list.tail = -1;
+        list.tail_used = WORKING_CHUNK_BYTES;
+        list.chunks = 0;
+    }
+    void put_bytes(list_t &list, const unsigned char *bytes, int n)
+    {
+        if (list.tail_used + n <= WORKING_CHUNK_BYTES)
+        { // fits the tail chunk
+            memcpy(this->arena[list.tail].bytes + list.tail_used, bytes, n);
+            list.tail_used += n;
+            return;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (list.tail_used == WORKING_CHUNK_BYTES)
+            {
+                int chunk = this->take_chunk();
+                if (list.tail >= 0)
+                {
+                    this->arena[list.tail].next = chunk;
+                }
+                else
+                {
+                    list.head = chunk;
+                    if (this->mem_limit > 0)
+                    {
+                        this->holders.push_back(&list - this->lists.data());
+                    }
+                }
+                list.tail = chunk;
+                list.tail_used = 0;
+                list.chunks++;
+            }
+            this->arena[list.tail].bytes[list.tail_used++] = bytes[i];
+        }
+    }
+    static int put_varint(unsigned char *out, unsigned long long v)
+    {
+        int n = 0;
+        while (v >= 0x80)
+        {
+            out[n++] = (unsigned char)(v | 0x80);
+            v >>= 7;
+        }
+        out[n++] = (unsigned char)v;
+        return n;
+    }
+    static unsigned long long zigzag(long long value)
+    {
+        return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+    }
+    // Log that process `handle` ran on `cpu` from `start_tick` to `end_tick`
+    void append(int handle, int start_tick, int end_tick, int cpu)
+    {
+        if (this->locked)
+        {
+            lock_guard<mutex> guard(this->append_lock);
+            this->append_unlocked(handle, start_tick, end_tick, cpu);
+        }
+        else
+        {
+            this->append_unlocked(handle, start_tick, end_tick, cpu);
+        }
+    }
+    void append_unlocked(int handle, int start_tick, int end_tick, int cpu)
+    {
+        list_t &list = this->lists[handle];
+        unsigned char bytes[30];
+        int n = put_varint(bytes, zigzag((long long)start_tick - list.last_tick));
+        n += put_varint(bytes + n, zigzag((long long)end_tick - start_tick));
+        if (this->with_cpus)
+        {
+            n += put_varint(bytes + n, cpu);
+        }
+        this->put_bytes(list, bytes, n);
+        list.intervals++;
+        list.last_tick = end_tick;
+        if (this->mem_limit > 0 && this->used_chunks * (long long)sizeof(chunk_t) > this->mem_limit)
+        {
+            this->spill();
+        }
+    }
+    // Move the longest lists to the spill file until the chunks in use take at most half of mem_limit. If the
+    // file cannot be written, spilling stops and the lists stay in memory
+    void spill()
+    {
+        if (this->spill_file == NULL && (this->spill_file = tmpfile()) == NULL)
+        {
+            cerr << "Cannot create a temporary file for the working intervals, they are kept in memory" << endl;
+            this->mem_limit = 0;
+            return;
+        }
+        vector<pair<int, int> > longest; // chunks, handle
+        sort(this->holders.begin(), this->holders.end());
+        this->holders.erase(unique(this->holders.begin(), this->holders.end()), this->holders.end());
+        for (size_t i = 0; i < this->holders.size(); i++)
+        {
+            if (this->lists[this->holders[i]].chunks > 0)
+            {
+                longest.push_back(make_pair(this->lists[this->holders[i]].chunks, this->holders[i]));
+            }
+        }
+        sort(longest.begin(), longest.end(), greater<pair<int, int> >());
+        vector<unsigned char> segment;
+        for (size_t i = 0; i < longest.size() && this->used_chunks * (long long)sizeof(chunk_t) > this->mem_limit / 2; i++)
+        {
+            list_t &list = this->lists[longest[i].second];
+            int length = (list.chunks - 1) * WORKING_CHUNK_BYTES + list.tail_used;
+            segment.resize(12 + length);
+            memcpy(segment.data(), &list.spilled, 8);
+            memcpy(segment.data() + 8, &length, 4);
+            size_t pos = 12;
+            for (int chunk = list.head; chunk >= 0; chunk = this->arena[chunk].next)
+            {
+                int n = chunk == list.tail ? list.tail_used : WORKING_CHUNK_BYTES;
+                memcpy(segment.data() + pos, this->arena[chunk].bytes, n);
+                pos += n;
+            }
+            if (fwrite(segment.data(), 1, segment.size(), this->spill_file) != segment.size())
+            {
+                cerr << "Cannot write the working intervals to a temporary file, they are kept in memory" << endl;
+                this->mem_limit = 0;
+                return;
+            }
+            list.spilled = this->spill_size;
+            this->spill_size += segment.size();
+            this->free_list(list);
+        }
+        this->holders.clear();
+        for (size_t i = 0; i < longest.size(); i++)
+        {
+            if (this->lists[longest[i].second].chunks > 0)
+            {
+                this->holders.push_back(longest[i].second);
+            }
+        }
+    }
+    // Forget the intervals of `handle`, its spilled segments stay in the file unused
+    void release(int handle)
+    {
+        list_t &list = this->lists[handle];
+        this->free_list(list);
+        list = list_t();
+    }
+
+    // Sequential reader of one list: its spilled segments, then its chunks
+    struct reader_t
+    {
+        const working_log_t &log;
+        vector<pair<long long, int> > segments; // file offset and length of every spilled segment, in order
+        size_t segment;
+        vector<unsigned char> buffer;
+        size_t pos, end;
+        long long file_pos; // of the next bytes of the current segment
+        int file_left;      // bytes of the current segment not read into the buffer yet
+        int chunk, chunk_pos;
+        bool failed;
+        reader_t(const working_log_t &log, const list_t &list)
+            : log(log), segment(0), pos(0), end(0), file_pos(0), file_left(0), chunk(list.head), chunk_pos(0), failed(false)
+        {
+            if (list.spilled < 0)
+            {
+                return;
+            }
+            fflush(log.spill_file);
+            for (long long offset = list.spilled; offset >= 0 && !this->failed;)
+            {
+                unsigned char header[12];
+                int length;
+                this->failed = pread(fileno(log.spill_file), header, 12, offset) != 12;
+                memcpy(&length, header + 8, 4);
+                this->segments.push_back(make_pair(offset + 12, length));
+                memcpy(&offset, header, 8);
+            }
+            reverse(this->segments.begin(), this->segments.end());
+            this->buffer.resize(WORKING_SPILL_BUFFER);
+        }
+        unsigned char get_byte()
+        {
+            if (this->pos < this->end)
+            {
+                return this->buffer[this->pos++];
+            }
+            while (this->file_left == 0 && this->segment < this->segments.size())
+            {
+                this->file_pos = this->segments[this->segment].first;
+                this->file_left = this->segments[this->segment].second;
+                this->segment++;
+            }
+            if (this->file_left > 0)
+            {
+                int n = min(this->file_left, WORKING_SPILL_BUFFER);
+                this->failed = this->failed || pread(fileno(this->log.spill_file), this->buffer.data(), n, this->file_pos) != n;
+                this->file_pos += n;
+                this->file_left -= n;
+                this->pos = 1;
+                this->end = n;
+                return this->buffer[0];
+            }
+            if (this->chunk_pos == WORKING_CHUNK_BYTES)
+            {
+                this->chunk = this->log.arena[this->chunk].next;
+                this->chunk_pos = 0;
+            }
+            return this->log.arena[this->chunk].bytes[this->chunk_pos++];
+        }
+        unsigned long long get_varint()
+        {
+            unsigned long long v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                unsigned char byte = this->get_byte();
+                v |= (unsigned long long)(byte & 0x7f) << shift;
+                if (byte < 0x80)
+                {
+                    break;
+                }
+            }
+            return v;
+        }
+        long long get_zigzag()
+        {
+            unsigned long long v = this->get_varint();
+            return (long long)(v >> 1) ^ -(long long)(v & 1);
+        }
+    };
+    // Call visit(start_tick, end_tick, cpu) for every interval of `handle` in order, false if the spill file
+    // could not be read back
+    template <class visit_t>
+    bool for_each(int handle, visit_t visit) const
+    {
+        const list_t &list = this->lists[handle];
+        reader_t in(*this, list);
+        long long tick = 0;
+        for (int i = 0; i < list.intervals && !in.failed; i++)
+        {
+            long long start = tick + in.get_zigzag();
+            tick = start + in.get_zigzag();
+            int cpu = this->with_cpus ? in.get_varint() : 0;
+            visit((int)start, (int)tick, cpu);
+        }
+        return !in.failed;
+    }
+};
+
+#define METRICS_HEADER "process,arrival,first_dispatch,completion,turnaround,waiting,response\n"
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define BINARY_LOG_MAGIC "SCHB"
+
+// Buffered writer of the output log, processes are appended as soon as they complete
+struct output_writer_t
+{
+    int fd;
+    int format; // output_format_t
+    bool failed;
+    vector<char> buffer;
+    size_t used;
+    string path;
+    long long flushed; // bytes in the file
+    bool live;         // flushed at the end of every tick that completes processes, for --stream
+
+    output_writer_t() : fd(-1), format(OUTPUT_TEXT), failed(false), used(0), flushed(0), live(false) {}
+
+
+    // Write to `file_path`, stdout if it is "-"
+    bool open(const char *file_path, int format)
+    {
+        this->format = format;
+        this->path = file_path == NULL ? "" : file_path;
+        if (format == OUTPUT_DISCARD)
+        {
+            return true;
+        }
+        this->fd = strcmp(file_path, "-") == 0 ? dup(STDOUT_FILENO) : ::open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        this->buffer.resize(OUTPUT_BUFFER_SIZE);
+        if (this->fd < 0)
+        {
+            return false;
+        }
+        if (format == OUTPUT_BINARY)
+        {
+            this->put_bytes(BINARY_LOG_MAGIC, 4);
+        }
+        else if (format == OUTPUT_METRICS)
+        {
+            this->put_text(METRICS_HEADER);
+        }
+        return true;
+    }
+
+    void flush()
+    {
+        size_t written = 0;
+        while (written < this->used && !this->failed)
+        {
+            ssize_t n = ::write(this->fd, this->buffer.data() + written, this->used - written);
+            if (n < 0)
+            {
+                this->failed = true;
+            }
+            else
+            {
+                written += n;
+            }
+        }
+        this->flushed += written;
+        this->used = 0;
+    }
+
+    // Continue the log of a run restored from a snapshot: keep the first `offset` bytes, copied from
+    // `prefix_path` when that is another file. Fails if the log there is shorter
+    bool resume(const char *file_path, int format, long long offset, const string &prefix_path)
+    {
+        this->format = format;
+        this->path = file_path;
+        if (format == OUTPUT_DISCARD)
+        {
+            return true;
+        }
+        this->buffer.resize(OUTPUT_BUFFER_SIZE);
+        struct stat file_stat;
+        if (prefix_path == this->path)
+        {
+            this->fd = ::open(file_path, O_WRONLY);
+            if (this->fd < 0 || fstat(this->fd, &file_stat) != 0 || file_stat.st_size < offset || ftruncate(this->fd, offset) != 0)
+            {
+                return false;
+            }
+            this->flushed = lseek(this->fd, offset, SEEK_SET);
+            return this->flushed == offset;
+        }
+        int prefix_fd = ::open(prefix_path.c_str(), O_RDONLY);
+        this->fd = ::open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        while (prefix_fd >= 0 && this->fd >= 0 && this->flushed + (long long)this->used < offset)
+        {
+            this->reserve(1);
+            size_t room = min((long long)(this->buffer.size() - this->used), offset - this->flushed - (long long)this->used);
+            ssize_t n = ::read(prefix_fd, this->buffer.data() + this->used, room);
+            if (n <= 0)
+            {
+                break;
+            }
+            this->used += n;
+        }
+        if (prefix_fd >= 0)
+        {
+            ::close(prefix_fd);
+        }
+        return this->fd >= 0 && this->flushed + (long long)this->used == offset;
+    }
+
+    // Flush and close the file, returns false if anything could not be written
+    bool close()
+    {
+        this->flush();
+        if (this->fd >= 0)
+        {
+            ::close(this->fd);
+        }
+        this->fd = -1;
+        return !this->failed;
+    }
+
+    // Make room for at least `n` more bytes in the buffer
+    void reserve(size_t n)
+    {
+        if (this->used + n > this->buffer.size())
+        {
+            this->flush();
+        }
+    }
+
+    void put_bytes(const char *bytes, size_t n)
+    {
+        this->reserve(n);
+        memcpy(this->buffer.data() + this->used, bytes, n);
+        this->used += n;
+    }
+
+    void put_text(const string &text)
+    {
+        this->put_bytes(text.data(), text.size());
+    }
+
+    // Append `value` in decimal followed by `separator`
+    void put_int(int value, char separator)
+    {
+        this->reserve(12);
+        char digits[11];
+        int n = 0;
+        unsigned int v = value < 0 ? 0u - (unsigned int)value : value;
+        do
+        {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v != 0);
+        char *out = this->buffer.data() + this->used;
+        if (value < 0)
+        {
+            *out++ = '-';
+        }
+        while (n > 0)
+        {
+            *out++ = digits[--n];
+        }
+        *out++ = separator;
+        this->used = out - this->buffer.data();
+    }
+
+    // Append `value` as a zigzag-encoded varint (small magnitudes of either sign take few bytes)
+    void put_varint(long long value)
+    {
+        this->reserve(10);
+        unsigned long long v = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+        while (v >= 0x80)
+        {
+            this->buffer[this->used++] = (char)(v | 0x80);
+            v >>= 7;
+        }
+        this->buffer[this->used++] = (char)v;
+    }
+
+    // One line of the OUTPUT_METRICS log, under METRICS_HEADER
+    void write_process_metrics(const process_t &p, const process_metrics_t &m)
+    {
+        this->put_int(p.process_id, ',');
+        this->put_int(p.arrival_time, ',');
+        this->put_int(p.first_dispatch_tick, ',');
+        this->put_int(m.completion_tick, ',');
+        this->put_int(m.turnaround, ',');
+        this->put_int(m.waiting, ',');
+        this->put_int(m.response, '\n');
+    }
+
+    // Write `p` with the working intervals `log` holds for `handle`, the CPU of each one with more than one CPU.
+    // Spilled intervals are streamed back from the spill file, the CPUs in a second pass
+    void write_process(const process_t &p, const working_log_t &log, int handle)
+    {
+        if (this->format == OUTPUT_DISCARD || this->format == OUTPUT_METRICS)
+        {
+            return;
+        }
+        long long length = 2LL * log.lists[handle].intervals;
+        bool read = true;
+        if (this->format == OUTPUT_BINARY)
+        {
+            this->put_varint(p.process_id);
+            this->put_varint(log.with_cpus ? -length : length);
+            int prev_tick = 0;
+            read = log.for_each(handle, [this, &prev_tick](int start_tick, int end_tick, int)
+                                {
+                                    this->put_varint((long long)start_tick - prev_tick);
+                                    this->put_varint((long long)end_tick - start_tick);
+                                    prev_tick = end_tick;
+                                });
+            if (log.with_cpus)
+            {
+                read = read && log.for_each(handle, [this](int, int, int cpu)
+                                            { this->put_varint(cpu); });
+            }
+        }
+        else
+        {
+            this->put_bytes("process ", 8);
+            this->put_int(p.process_id, '\n');
+            read = log.for_each(handle, [this](int start_tick, int end_tick, int)
+                                {
+                                    this->put_int(start_tick, ' ');
+                                    this->put_int(end_tick, ' ');
+                                });
+            this->put_bytes("\n", 1);
+            if (log.with_cpus)
+            {
+                this->put_bytes("cpu ", 4);
+                read = read && log.for_each(handle, [this](int, int, int cpu)
+                                            { this->put_int(cpu, ' '); });
+                this->put_bytes("\n", 1);
+            }
+        }
+        if (!read && !this->failed)
+        {
+            cerr << "Cannot read the working intervals back from the temporary file" << endl;
+            this->failed = true;
+        }
+    }
+};
+
+#define HISTOGRAM_EXACT 16 // latencies below this are counted exactly, larger ones in 16 sub-buckets per power of two
+#define HISTOGRAM_BUCKETS (HISTOGRAM_EXACT + 59 * 16)
+
+// Write out the processes that completed at `completion_tick` and release their working logs
+void write_done_processes(vector<process_t> &processes, const vector<service_t> &services, const vector<int> &drawn_costs,
+                          ring_queue_t &processes_done, working_log_t &working, int completion_tick, output_writer_t &output,
+                          run_summary_t &summary);
+
+// Report of a run at the end of an OUTPUT_METRICS log: latency percentiles, the utilisation of every CPU
+// and the waiting statistics of every queue
+void write_metrics_report(output_writer_t &output, const run_summary_t &summary);
+
+// Events of the trace. The resource column holds the CPU unless noted otherwise
+enum trace_event_t
+{
+    TRACE_ARRIVAL,        // the process joins the run queue of the CPU
+    TRACE_DISPATCH,
+    TRACE_PREEMPT,        // at the last tick the process ran, it stays ready
+    TRACE_DEMOTE,         // resource: the FB level the preempted process moves down to
+    TRACE_BLOCK_DEVICE,   // resource: the device, 0 for D and 1 for K
+    TRACE_BLOCK_MUTEX,    // resource: the mutex
+    TRACE_UNBLOCK_DEVICE, // resource: the device whose I/O is completed
+    TRACE_UNBLOCK_MUTEX,  // resource: the mutex handed over to the process, which holds it from now on
+    TRACE_LOCK,           // resource: the mutex, which was free
+    TRACE_UNLOCK,         // resource: the mutex
+    TRACE_MIGRATE,        // the process was stolen by the CPU
+    TRACE_COMPLETE
+};
+
+#define TRACE_MAGIC "SCHT"
+#define TRACE_BLOCK_EVENTS 4096 // a CPU's buffer is written out once it holds that many events, small enough to stay in cache
+
+// One event of the trace, as decode-trace reads it back
+struct trace_record_t
+{
+    int tick;
+    int process_id;
+    int resource;
+    unsigned char event; // trace_event_t
+};
+
+// A full block of the file as it is written: the columns of TRACE_BLOCK_EVENTS events, a multiple of 4 so
+// that it needs no padding
+struct trace_block_t
+{
+    int ticks[TRACE_BLOCK_EVENTS];
+    int process_ids[TRACE_BLOCK_EVENTS];
+    int resources[TRACE_BLOCK_EVENTS];
+    unsigned char events[TRACE_BLOCK_EVENTS];
+};
+
+// Events of one CPU, kept in the columns of blocks of the file so that a flush writes them as they are. Only
+// the thread running the CPU in a tick appends to it, the buffers of two CPUs never share a cache line
+struct alignas(64) trace_buffer_t
+{
+    vector<unique_ptr<trace_block_t> > blocks; // kept from one flush to the next
+    size_t full;                                // blocks filled since the last flush, blocks[full] is being filled
+    trace_block_t *block;                       // blocks[full]
+    int size;                                   // events in `block`
+    trace_buffer_t() : full(0), size(0)
+    {
+        this->blocks.push_back(unique_ptr<trace_block_t>(new trace_block_t));
+        this->block = this->blocks[0].get();
+    }
+};
+
+// Event trace of a run, for analysis after the fact. The file is laid out to be mapped into memory and
+// read column by column, every integer is 32-bit little-endian:
+//   "SCHT", the number of devices and their names, the number of mutexes and their names (names end
+//   with a 0 byte, each list is padded to 4 bytes)
+//   then blocks until the end of the file: the number of events n, the CPU, then columns of n ticks, n
+//   process IDs, n resources and n one-byte events, padded to 4 bytes
+// The events of a block are in order, blocks of different CPUs overlap in time
+struct trace_writer_t
+{
+    int fd;
+    bool failed;
+    bool threaded; // CPUs append from several threads, a full block waits for flush_full() at the end of the tick
+    vector<trace_buffer_t> buffers; // per CPU
+    trace_writer_t() : fd(-1), failed(false), threaded(false) {}
+
+    bool open(const char *file_path, const resource_table_t &resources, int cpus)
+    {
+        this->fd = ::open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (this->fd < 0)
+        {
+            return false;
+        }
+        this->buffers.resize(cpus);
+        string header = TRACE_MAGIC;
+        const vector<string> *tables[] = {&resources.device_names, &resources.mutex_names};
+        for (int t = 0; t < 2; t++)
+        {
+            int n = tables[t]->size();
+            header.append((const char *)&n, sizeof(n));
+            size_t names_begin = header.size();
+            for (size_t i = 0; i < tables[t]->size(); i++)
+            {
+                header.append((*tables[t])[i].c_str(), (*tables[t])[i].size() + 1);
+            }
+            header.append((4 - (header.size() - names_begin) % 4) % 4, '\0');
+        }
+        struct iovec part = {(void *)header.data(), header.size()};
+        this->write_parts(&part, 1);
+        return !this->failed;
+    }
+    // Write all of `parts` with as few system calls as possible
+    void write_parts(struct iovec *parts, int count)
+    {
+        while (count > 0 && !this->failed)
+        {
+            ssize_t n = writev(this->fd, parts, count);
+            if (n < 0)
+            {
+                this->failed = true;
+                return;
+            }
+            while (count > 0 && (size_t)n >= parts->iov_len)
+            {
+                n -= parts->iov_len;
+                parts++;
+                count--;
+            }
+            if (count > 0)
+            {
+                parts->iov_base = (char *)parts->iov_base + n;
+                parts->iov_len -= n;
+            }
+        }
+    }
+
+    // Append an event to the buffer of `cpu`: four stores at fixed offsets
+    TICK_INLINE void add(int cpu, int tick, int process_id, int resource, int event)
+    {
+        trace_buffer_t &buffer = this->buffers[cpu];
+        if (buffer.size == TRACE_BLOCK_EVENTS)
+        {
+            this->next_block(cpu);
+        }
+        trace_block_t *block = buffer.block;
+        int i = buffer.size++;
+        block->ticks[i] = tick;
+        block->process_ids[i] = process_id;
+        block->resources[i] = resource;
+        block->events[i] = event;
+    }
+    // Make room in the buffer of `cpu`, whose block is full: write it out, or go on in the next one if the
+    // CPUs run on several threads. Out of line as it is rare
+    void next_block(int cpu);
+
+    // Write the events of `cpu` a block at a time, straight from its columns
+    void flush(int cpu)
+    {
+        trace_buffer_t &buffer = this->buffers[cpu];
+        static const unsigned char padding[3] = {0, 0, 0};
+        for (size_t b = 0; b <= buffer.full; b++)
+        {
+            trace_block_t *block = buffer.blocks[b].get();
+            int n = b < buffer.full ? TRACE_BLOCK_EVENTS : buffer.size;
+            int header[2] = {n, cpu};
+            if (n == TRACE_BLOCK_EVENTS)
+            { // the columns are laid out as in the file
+                struct iovec parts[] = {{header, sizeof(header)}, {block, sizeof(trace_block_t)}};
+                this->write_parts(parts, 2);
+            }
+            else if (n > 0)
+            {
+                struct iovec parts[] = {{header, sizeof(header)},
+                                        {block->ticks, n * sizeof(int)},
+                                        {block->process_ids, n * sizeof(int)},
+                                        {block->resources, n * sizeof(int)},
+                                        {block->events, (size_t)n},
+                                        {(void *)padding, (size_t)(4 - n % 4) % 4}};
+                this->write_parts(parts, 6);
+            }
+        }
+        buffer.full = 0;
+        buffer.block = buffer.blocks[0].get();
+        buffer.size = 0;
+    }
+    // Write out the buffers with a full block, called between two ticks of a threaded run
+    void flush_full()
+    {
+        for (size_t cpu = 0; cpu < this->buffers.size(); cpu++)
+        {
+            if (this->buffers[cpu].full > 0)
+            {
+                this->flush(cpu);
+            }
+        }
+    }
+    bool close()
+    {
+        for (size_t cpu = 0; cpu < this->buffers.size(); cpu++)
+        {
+            this->flush(cpu);
+        }
+        if (this->fd >= 0 && ::close(this->fd) != 0)
+        {
+            this->failed = true;
+        }
+        this->fd = -1;
+        return !this->failed;
+    }
+};
+
+#define LOD_MAGIC "SCHL"
+#define LOD_TILE_ROWS 256     // processes of a tile of the level-of-detail pyramid
+#define LOD_TILE_COLUMNS 4096 // time buckets of a tile, working intervals are much longer than they are high
+
+#define LOD_PENDING_RUNS (1 << 19) // runs of level 0 kept in memory before the biggest bands are spilled
+#define LOD_READ_RUNS 256         // runs read from a spill file at once
+
+// Cells of a row of one pyramid level with the same value
+struct lod_run_t
+{
+    int column;            // of the first cell, in the whole level
+    short row;             // in the tile
+    unsigned short length; // cells
+    long long value;       // busy ticks of the processes of every cell
+};
+
+// Level-of-detail pyramid of a run, for vis.html to draw runs with millions of working intervals: per
+// process and time bucket, the share of the bucket spent on a CPU. Level 0 has a cell per process and
+// tick, every level above merges 4 ticks into a cell, and 4 processes as well once the rows need more
+// levels than the ticks to fit a tile, up to a single tile at the top. Tiles are 256 processes by 4096
+// buckets, only the non-empty ones are written, as runs of equal cells. Integers are little-endian:
+//   "SCHL", then the runs of every tile, 6 bytes each: the row of the first cell in the tile and the
+//   occupancy 1..255 (busy ticks scaled to the ticks of the cell) in a byte each, the column of the first
+//   cell in the tile and the number of cells - 1 in 16 bits each
+//   the directory, in 32 bits: the number of rows (highest process ID + 1), the last tick, the number of levels, then
+//   per level from 0 the ticks and processes of a cell, the number of tiles and per tile its row and
+//   column in the level, its number of runs and the file offset of the runs, low and high 32 bits
+//   the file offset of the directory, low and high 32 bits
+// A viewer reads the directory and the top tile, then only the tiles of the region it zooms into
+// The cells of level 0 are collected per band of 256 processes, as the processes complete. A band goes to a
+// temporary file as a chunk of runs sorted by tile, row and column once all its processes have completed,
+// or when the bands in memory hold more than LOD_PENDING_RUNS runs. Every level is then built from the
+// chunks of the one below, a tile at a time, and leaves its own chunks for the next
+struct lod_builder_t
+{
+    struct chunk_t
+    {
+        long long offset; // in the spill file
+        int runs;
+    };
+    struct band_t
+    {
+        vector<lod_run_t> runs; // not spilled yet
+        vector<chunk_t> chunks;
+        int pending = 0; // processes expected to complete
+    };
+    vector<band_t> bands;
+    FILE *spill_file;
+    long long spill_size;
+    long long pending_runs; // in memory, over all bands
+    vector<pair<int, int> > edges; // tick and +1 or -1 at the start and end of every interval of a process
+    int rows;
+    int last_tick;
+    bool failed;
+    lod_builder_t() : spill_file(NULL), spill_size(0), pending_runs(0), rows(0), last_tick(0), failed(false) {}
+    ~lod_builder_t()
+    {
+        if (this->spill_file != NULL)
+        {
+            fclose(this->spill_file);
+        }
+    }
+
+    // Expect process `process_id` to complete, its band is spilled once all of them have
+    void expect(int process_id)
+    {
+        size_t band = process_id / LOD_TILE_ROWS;
+        if (band >= this->bands.size())
+        {
+            this->bands.resize(band + 1);
+        }
+        this->bands[band].pending++;
+    }
+    // Add the working intervals of a completed process, `handle` in `log`, to the cells of level 0
+    void add(const process_t &p, const working_log_t &log, int handle);
+    // Append the runs of `band` in memory to the spill file as a chunk
+    bool spill(band_t &band);
+
+    // Number of levels merging 4 cells into 1 until `n` cells fit `size`
+    static int levels_to_fit(long long n, int size)
+    {
+        int levels = 0;
+        for (; n > size; n = (n + 3) / 4)
+        {
+            levels++;
+        }
+        return levels;
+    }
+
+    static void put_run(output_writer_t &file, const lod_run_t &run)
+    {
+        int column = run.column % LOD_TILE_COLUMNS;
+        unsigned char bytes[6] = {(unsigned char)run.row, (unsigned char)run.value,
+                                  (unsigned char)(column & 0xff), (unsigned char)(column >> 8),
+                                  (unsigned char)((run.length - 1) & 0xff), (unsigned char)((run.length - 1) >> 8)};
+        file.put_bytes((const char *)bytes, sizeof(bytes));
+    }
+
+    bool write(const char *file_path);
+};
+
+// Split a string according to a delimiter
+void split(const string &s, vector<string> &tokens, const string &delim = " ");
+
+// Order of admission: by arrival time, then by process ID
+bool arrives_before(const process_t &a, const process_t &b);
+
+// Read processes sorted by arrival time, their services are appended to `services`
+vector<process_t> read_processes(const char *file_path, vector<service_t> &services, resource_table_t &resources);
+
+// Cursor over a memory-mapped process file
+struct input_cursor_t
+{
+    const char *pos;
+    const char *end;
+    int line; // number of the line `pos` is on, starting from 1
+};
+
+bool is_blank(char c);
+
+void skip_blanks(input_cursor_t &in);
+
+// Parse a decimal integer, fails if there is none or it does not fit into an int
+bool parse_int(input_cursor_t &in, int &value);
+
+// Read a word such as a mutex or device name into `word`, fails if there is none
+bool parse_word(input_cursor_t &in, string &word);
+
+// Move to the start of the next line, fails if anything but blanks is left on the current one
+bool next_line(input_cursor_t &in);
+
+bool parse_error(const input_cursor_t &in, const char *file_path, const char *message);
+
+// Number of occurrences of `c` in [begin, end)
+size_t count_char(const char *begin, const char *end, char c);
+
+struct distribution_t;
+
+// Parse all processes in one pass, writing straight into the process and service storage.
+// A C, K or D cost may be a distribution ("C exp:12"), appended to `dists`; without `dists` only fixed costs parse
+bool parse_processes(input_cursor_t &in, const char *file_path, vector<process_t> &processes, vector<service_t> &services,
+                     resource_table_t &resources, vector<distribution_t> *dists = NULL);
+
+// Memory-mapped alternative to read_processes(): no per-line allocation, malformed lines are reported
+// with their line number. Returns false if the file cannot be read or is malformed
+bool load_processes(const char *file_path, vector<process_t> &processes, vector<service_t> &services, resource_table_t &resources,
+                    vector<distribution_t> *dists = NULL);
+
+// splitmix64: small, fast and gives the same stream on every platform, unlike the <random> distributions
+struct rng_t
+{
+    unsigned long long state;
+    rng_t(unsigned long long seed) : state(seed) {}
+
+    unsigned long long next()
+    {
+        unsigned long long z = (this->state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [lo, hi]
+    int range(int lo, int hi)
+    {
+        return lo + (int)(this->next() % (unsigned long long)(hi - lo + 1));
+    }
+};
+
+// Kinds of distribution_t
+enum distribution_kind_t
+{
+    DIST_FIXED,   // "fixed:N"
+    DIST_UNIFORM, // "uniform:LO:HI", both included
+    DIST_EXP,     // "exp:MEAN", rounded to whole ticks
+    DIST_LOGNORM  // "lognorm:MEAN:SD", mean and standard deviation of the ticks themselves, rounded
+};
+
+// Distribution of a synthetic duration or of a stochastic service cost in ticks.
+// ',' separates the parameters as well as ':', except inside a synthetic spec where ',' separates options
+struct distribution_t
+{
+    int kind; // distribution_kind_t
+    int lo;
+    int hi;
+    double mean;
+    double sd; // DIST_LOGNORM only
+    distribution_t(int kind = DIST_FIXED, int lo = 0, int hi = 0) : kind(kind), lo(lo), hi(hi), mean((lo + hi) / 2.0), sd(0) {}
+
+    int sample(rng_t &rng) const
+    {
+        if (this->kind == DIST_UNIFORM)
+        {
+            return rng.range(this->lo, this->hi);
+        }
+        if (this->kind == DIST_EXP)
+        {
+            double u = (rng.next() >> 11) * (1.0 / (1ULL << 53)); // in [0, 1)
+            return (int)min(-this->mean * log(1 - u) + 0.5, 1e8);
+        }
+        if (this->kind == DIST_LOGNORM)
+        { // Box-Muller for the underlying normal, whose parameters give back `mean` and `sd`
+            double u1 = ((rng.next() >> 11) + 1) * (1.0 / (1ULL << 53)); // in (0, 1]
+            double u2 = (rng.next() >> 11) * (1.0 / (1ULL << 53));
+            double sigma2 = log(1 + this->sd * this->sd / (this->mean * this->mean));
+            double z = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+            return (int)min(exp(log(this->mean) - sigma2 / 2 + sqrt(sigma2) * z) + 0.5, 1e8);
+        }
+        return this->lo;
+    }
+    bool parse(const string &text)
+    {
+        vector<string> tokens;
+        split(text, tokens, ":,");
+        vector<double> values;
+        bool whole = true; // fixed and uniform take whole ticks only
+        for (size_t i = 1; i < tokens.size(); i++)
+        {
+            char *end;
+            values.push_back(strtod(tokens[i].c_str(), &end));
+            if (*end != '\0' || values.back() < 0 || values.back() > 1e8)
+            {
+                return false;
+            }
+            whole = whole && values.back() == floor(values.back());
+        }
+        if (tokens.empty() || ((tokens[0] == "fixed" || tokens[0] == "uniform") && !whole))
+        {
+            return false;
+        }
+        if (tokens.size() == 2 && tokens[0] == "fixed")
+        {
+            *this = distribution_t(DIST_FIXED, values[0], values[0]);
+        }
+        else if (tokens.size() == 3 && tokens[0] == "uniform" && values[0] <= values[1])
+        {
+            *this = distribution_t(DIST_UNIFORM, values[0], values[1]);
+        }
+        else if (tokens.size() == 2 && tokens[0] == "exp")
+        {
+            *this = distribution_t(DIST_EXP);
+            this->mean = values[0];
+        }
+        else if (tokens.size() == 3 && tokens[0] == "lognorm" && values[0] > 0)
+        {
+            *this = distribution_t(DIST_LOGNORM);
+            this->mean = values[0];
+            this->sd = values[1];
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+};
+
+#define SYNTHETIC_MAX_SLOTS 8 // services drawn per process, a final CPU burst is always added
+
+// Shape of a synthetic workload: the service mix is given as relative weights
+struct synthetic_spec_t
+{
+    int processes;
+    int cpu_weight;          // CPU bursts
+    int io_weight;           // disk or keyboard requests
+    int mutex_weight;        // critical sections "L m, C, U m"
+    bool auto_arrival;       // arrival gaps are drawn so that the CPU is about fully loaded, instead of from `arrival`
+    distribution_t arrival;  // ticks between two arrivals
+    distribution_t burst;    // length of a CPU burst, inside critical sections too
+    distribution_t io;       // length of an I/O request
+    int mutexes;             // mutexes the critical sections pick from
+    bool nested;             // critical sections lock two mutexes, in id order, instead of one
+    unsigned long long seed;
+    synthetic_spec_t()
+        : processes(1000), cpu_weight(70), io_weight(20), mutex_weight(10), auto_arrival(true), burst(DIST_UNIFORM, 1, 20),
+          io(DIST_UNIFORM, 1, 10), mutexes(4), nested(false), seed(1) {}
+
+    // Most services a process can have
+    int max_services() const
+    {
+        return SYNTHETIC_MAX_SLOTS * (this->nested ? 5 : 3) + 1;
+    }
+};
+
+// Source of processes that come while a run goes instead of from a process table: one at a time in order
+// of arrival then ID, into entries of the process pool that are reused once their process completes
+struct process_source_t
+{
+    virtual ~process_source_t() {}
+    // Arrival tick of the next process, NO_EVENT once all of them are out
+    virtual int next_arrival() = 0;
+    // Most services the next process can have, asked right before next()
+    virtual int max_services() = 0;
+    // Take the next process, its services go to `services` (room for max_services())
+    virtual void next(process_t &p, service_t *services) = 0;
+};
+
+// Lazy generator of a synthetic workload: processes come out one at a time in arrival order, so a run
+// only holds the ones that have arrived and not completed yet. The same seed gives the same processes
+struct synthetic_source_t : process_source_t
+{
+    synthetic_spec_t spec;
+    rng_t rng;
+    int total_weight;
+    int mean_gap;           // with auto_arrival
+    int next_id;
+    int next_arrival_tick;
+    vector<int> mutex_names; // mutex picked -> number in its name, numbered by first use
+    synthetic_source_t(const synthetic_spec_t &spec)
+        : spec(spec), rng(spec.seed), total_weight(spec.cpu_weight + spec.io_weight + spec.mutex_weight), next_id(0),
+          next_arrival_tick(0), mutex_names(spec.mutexes, -1)
+    {
+        // CPU ticks of an average process: (1 + SYNTHETIC_MAX_SLOTS) / 2 slots of which the CPU and mutex
+        // ones hold a burst, plus the final burst
+        double cpu_share = this->total_weight == 0 ? 0 : (double)(spec.cpu_weight + spec.mutex_weight) / this->total_weight;
+        this->mean_gap = (int)((1 + SYNTHETIC_MAX_SLOTS) / 2.0 * cpu_share * spec.burst.mean + spec.burst.mean);
+    }
+
+    int next_arrival()
+    {
+        return this->next_id < this->spec.processes ? this->next_arrival_tick : NO_EVENT;
+    }
+    int max_services()
+    {
+        return this->spec.max_services();
+    }
+    // Mutex id of the `pick`-th mutex. Ids follow the order of first use, which is also the order a
+    // process file written from this source interns them in
+    int mutex_id(int pick)
+    {
+        if (this->mutex_names[pick] < 0)
+        {
+            this->mutex_names[pick] = *max_element(this->mutex_names.begin(), this->mutex_names.end()) + 1;
+        }
+        return this->mutex_names[pick];
+    }
+    void add_service(service_t *services, int &n, int type, int time_cost, int resource)
+    {
+        services[n].type = type;
+        services[n].time_cost = time_cost;
+        services[n].resource = resource;
+        n++;
+    }
+    // Generate the next process
+    void next(process_t &p, service_t *services)
+    {
+        int n = 0;
+        int slots = this->rng.range(1, SYNTHETIC_MAX_SLOTS);
+        for (int i = 0; i < slots && this->total_weight > 0; i++)
+        {
+            int pick = this->rng.range(0, this->total_weight - 1);
+            if (pick < this->spec.cpu_weight)
+            {
+                this->add_service(services, n, SERVICE_C, this->spec.burst.sample(this->rng), 0);
+            }
+            else if (pick < this->spec.cpu_weight + this->spec.io_weight)
+            {
+                int type = this->rng.range(0, 1) == 0 ? SERVICE_D : SERVICE_K;
+                this->add_service(services, n, type, this->spec.io.sample(this->rng), type == SERVICE_D ? DEVICE_DISK : DEVICE_KEYBOARD);
+            }
+            else
+            {
+                int outer = this->mutex_id(this->rng.range(0, this->spec.mutexes - 1));
+                int inner = -1;
+                if (this->spec.nested && this->spec.mutexes > 1)
+                { // a second, different mutex, both are locked in id order so that sections never deadlock
+                    int pick = this->rng.range(0, this->spec.mutexes - 2);
+                    inner = this->mutex_id(pick >= outer ? pick + 1 : pick);
+                    if (inner < outer)
+                    {
+                        swap(inner, outer);
+                    }
+                }
+                this->add_service(services, n, SERVICE_L, 0, outer);
+                if (inner >= 0)
+                {
+                    this->add_service(services, n, SERVICE_L, 0, inner);
+                }
+                this->add_service(services, n, SERVICE_C, this->spec.burst.sample(this->rng), 0);
+                if (inner >= 0)
+                {
+                    this->add_service(services, n, SERVICE_U, 0, inner);
+                }
+                this->add_service(services, n, SERVICE_U, 0, outer);
+            }
+        }
+        this->add_service(services, n, SERVICE_C, this->spec.burst.sample(this->rng), 0);
+        p = process_t();
+        p.process_id = this->next_id++;
+        p.arrival_time = this->next_arrival_tick;
+        p.service_num = n;
+        int gap = this->spec.auto_arrival ? this->rng.range(0, 2 * this->mean_gap) : this->spec.arrival.sample(this->rng);
+        this->next_arrival_tick = (int)min((long long)this->next_arrival_tick + gap, (long long)MAX_TICK + 1);
+    }
+};
+
+// Write the processes of a synthetic workload as a process file
+bool write_synthetic_workload(const synthetic_spec_t &spec, const char *file_path);
+
+// Processes read from a pipe or stdin while the run goes (--stream), in the process file format. They have
+// to come in order of arrival, so the run can go on up to the arrival of the last process read. The ones
+// arriving in the same tick are admitted in order of ID: the first of them is only known once a later
+// arrival or the end of the input is read. Only the processes read and not admitted yet are held, their
+// devices and mutexes go to `resources`
+struct stream_source_t : process_source_t
+{
+    struct record_t
+    {
+        process_t process;
+        vector<service_t> services;
+    };
+    FILE *file;
+    string path;
+    resource_table_t &resources;
+    deque<record_t> pending; // read and not taken yet, in order of arrival then ID
+    int line;                // lines read so far
+    int last_arrival;        // arrival of the last process read
+    bool at_end;
+    bool failed; // the input is malformed, nothing is read after the error
+    char *line_buffer;
+    size_t line_capacity;
+
+    stream_source_t(resource_table_t &resources)
+        : file(NULL), resources(resources), line(0), last_arrival(0), at_end(false), failed(false), line_buffer(NULL), line_capacity(0) {}
+    stream_source_t(const stream_source_t &) = delete;
+    stream_source_t &operator=(const stream_source_t &) = delete;
+    ~stream_source_t()
+    {
+        if (this->file != NULL && this->file != stdin)
+        {
+            fclose(this->file);
+        }
+        free(this->line_buffer);
+    }
+
+    // Read from `file_path`, stdin if it is "-"
+    bool open(const char *file_path);
+    // Read the next process record into `pending`, sets `at_end` or `failed` when there is none
+    void read_record();
+
+    int next_arrival()
+    {
+        while (this->pending.empty() && !this->at_end && !this->failed)
+        {
+            this->read_record();
+        }
+        return this->pending.empty() || this->failed ? NO_EVENT : this->pending.front().process.arrival_time;
+    }
+    int max_services()
+    {
+        while (this->pending.back().process.arrival_time == this->pending.front().process.arrival_time && !this->at_end && !this->failed)
+        { // every process of the tick is read
+            this->read_record();
+        }
+        return this->pending.front().process.service_num;
+    }
+    void next(process_t &p, service_t *services)
+    {
+        record_t &record = this->pending.front();
+        p = record.process;
+        copy(record.services.begin(), record.services.end(), services);
+        this->pending.pop_front();
+    }
+};
+
+// move the process at the front of q1 to the back of q2 (q1 head -> q2 tail)
+inline int move_process_from(ring_queue_t &q1, ring_queue_t &q2)
+{
+    if (!q1.empty())
+    {
+        q2.push_back(q1.pop_front());
+        return 1;
+    }
+    return 0;
+}
+
+// Parsed process file, shared read-only by every simulation run on it: each run copies the process
+// table into its own pool, the service arena is never copied
+struct workload_t
+{
+    vector<process_t> processes;
+    vector<service_t> services;
+    resource_table_t resources;
+    vector<distribution_t> cost_dists; // distribution of every stochastic service cost, see service_t::draw
+    bool synthetic;         // no process table: every run generates the processes from `spec` as they arrive
+    synthetic_spec_t spec;
+    stream_source_t *stream; // no process table: the processes are read from it as they arrive, by a single run
+    workload_t() : synthetic(false), stream(NULL) {}
+};
+
+#define WHEEL_BITS 6   // a level of the timing wheel has 64 slots, one bit each in a 64-bit word
+#define WHEEL_LEVELS 6 // 36 bits, any tick fits
+
+// Hierarchical timing wheel holding at most one pending event per id, keyed by the tick it is due. Level l
+// has 64 slots of 64^l ticks. An event sits at the highest level at which its tick and the current tick
+// differ, so the current slot of level 0 holds exactly the events due now and the lowest occupied slot of
+// the lowest occupied level the next ones. Moving on to a later tick cascades the one slot it enters at
+// the highest changed level down to the lower levels. The wheel only moves when an event is due: ticks
+// before the earliest event cost a comparison, events are placed relative to an earlier tick meanwhile
+struct timing_wheel_t
+{
+    vector<int> due;  // tick of the pending event of every id
+    vector<int> next; // next id in the same slot, -1 at the end of the list
+    int heads[WHEEL_LEVELS][1 << WHEEL_BITS]; // first id of every slot, -1 if it is empty
+    unsigned long long occupied[WHEEL_LEVELS]; // bit s is set if slot s holds events
+    int now;   // no event is due before it
+    int first; // tick of the earliest event, NO_EVENT if there is none
+
+    timing_wheel_t()
+    {
+        this->clear(0);
+    }
+    void clear(int tick)
+    {
+        fill(&this->heads[0][0], &this->heads[0][0] + WHEEL_LEVELS * (1 << WHEEL_BITS), -1);
+        fill(this->occupied, this->occupied + WHEEL_LEVELS, 0);
+        this->now = tick;
+        this->first = NO_EVENT;
+    }
+
+    // Level of an event due at `tick`: the highest digit of 6 bits where it differs from `now`
+    static int level_of(int tick, int now)
+    {
+        unsigned int diff = tick ^ now;
+        return diff == 0 ? 0 : (31 - __builtin_clz(diff)) / WHEEL_BITS;
+    }
+    void insert(int id)
+    {
+        int level = level_of(this->due[id], this->now);
+        int slot = (this->due[id] >> (level * WHEEL_BITS)) & ((1 << WHEEL_BITS) - 1);
+        this->next[id] = this->heads[level][slot];
+        this->heads[level][slot] = id;
+        this->occupied[level] |= 1ULL << slot;
+    }
+    // Schedule the event of `id` at `tick`, no earlier than the current tick
+    void add(int id, int tick)
+    {
+        if (id >= (int)this->due.size())
+        {
+            this->due.resize(id + 1);
+            this->next.resize(id + 1);
+        }
+        this->due[id] = tick;
+        this->insert(id);
+        this->first = min(this->first, tick);
+    }
+
+    // Move on to `tick`, no later than the earliest event, and append the ids of the events due then to `ids`
+    void advance(int tick, vector<int> &ids)
+    {
+        if (tick < this->first)
+        {
+            return;
+        }
+        if (tick != this->now)
+        { // below the highest changed digit every level is empty, nothing is due before `tick`
+            int level = level_of(tick, this->now);
+            this->now = tick;
+            int slot = (tick >> (level * WHEEL_BITS)) & ((1 << WHEEL_BITS) - 1);
+            if (level > 0 && (this->occupied[level] >> slot & 1))
+            {
+                int id = this->heads[level][slot];
+                this->heads[level][slot] = -1;
+                this->occupied[level] &= ~(1ULL << slot);
+                while (id >= 0)
+                {
+                    int next = this->next[id];
+                    this->insert(id);
+                    id = next;
+                }
+            }
+        }
+        int slot = tick & ((1 << WHEEL_BITS) - 1);
+        for (int id = this->heads[0][slot]; id >= 0; id = this->next[id])
+        {
+            ids.push_back(id);
+        }
+        this->heads[0][slot] = -1;
+        this->occupied[0] &= ~(1ULL << slot);
+        this->first = this->earliest();
+    }
+
+    // Tick of the earliest event, NO_EVENT if there is none
+    int earliest() const
+    {
+        for (int level = 0; level < WHEEL_LEVELS; level++)
+        {
+            if (this->occupied[level] != 0)
+            {
+                int slot = __builtin_ctzll(this->occupied[level]);
+                if (level == 0)
+                {
+                    return (this->now & ~((1 << WHEEL_BITS) - 1)) | slot;
+                }
+                int tick = NO_EVENT;
+                for (int id = this->heads[level][slot]; id >= 0; id = this->next[id])
+                {
+                    tick = min(tick, this->due[id]);
+                }
+                return tick;
+            }
+        }
+        return NO_EVENT;
+    }
+};
+
+// State of one simulated CPU
+struct cpu_state_t
+{
+    int dispatched_tick;
+    int prev_process_id;
+    int running;       // process run in the current tick
+    bool service_done; // the running process completed its service in the current tick
+    int traced_process_id; // process on the CPU as far as the event trace knows, -1 if none
+    long long busy_ticks;                 // ticks this CPU ran a process, counted as they are simulated or skipped
+    vector<queue_metrics_t> ready_queues; // waits in the run queue, per FB level (every other policy has level 0 only)
+    cpu_state_t(int levels)
+        : dispatched_tick(0), prev_process_id(-1), running(-1), service_done(false), traced_process_id(-1), busy_ticks(0), ready_queues(levels)
+    {
+    }
+};
+
+#ifdef SCHED_PROFILE
+// Phases of an iteration of the simulation loop, timed by --profile
+enum profile_phase_t
+{
+    PROFILE_CHECKPOINT, // snapshots
+    PROFILE_ADMIT,      // long-term scheduler
+    PROFILE_DEVICES,    // I/O device block queues
+    PROFILE_MUTEXES,    // mutex block queues
+    PROFILE_STEAL,      // idle CPUs taking work
+    PROFILE_CPUS,       // dispatch and one tick of every CPU
+    PROFILE_SERVICES,   // completed services: manage_next_service()
+    PROFILE_OUTPUT,     // writing completed processes, trace and pyramid
+    PROFILE_SKIP,       // finding and skipping quiet ticks
+    PROFILE_PHASES
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+// Time stamp counter: constant rate on current x86, a few cycles to read and not serialising, so a lap
+// is off by a few dozen cycles at most
+inline unsigned long long profile_clock()
+{
+    return __rdtsc();
+}
+#else
+inline unsigned long long profile_clock()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Counters of --profile, only in builds with -DSCHED_PROFILE. Everything is updated by the thread that
+// runs the simulation loop
+struct profiler_t
+{
+    unsigned long long clocks[PROFILE_PHASES]; // profile_clock() counts spent in each phase
+    long long calls[PROFILE_PHASES];
+    long long iterations;
+    long long manage_calls;    // manage_next_service() calls
+    long long manage_services; // services it went through, the mutex operations executed on the spot included
+    vector<int> ready_max;     // high-water marks of the run queue of every CPU
+    vector<int> device_max;    // of the block queue of every device
+    vector<int> mutex_max;     // of the block queue of every mutex
+    int done_max;              // processes completed in one tick
+    unsigned long long lap_overhead; // clocks of an empty lap, taken off every lap in the report
+    unsigned long long start_clock;
+    chrono::steady_clock::time_point start_time;
+
+    profiler_t(int cpus, int devices, int mutexes)
+        : iterations(0), manage_calls(0), manage_services(0), ready_max(cpus), device_max(devices), mutex_max(mutexes), done_max(0),
+          start_clock(profile_clock()), start_time(chrono::steady_clock::now())
+    {
+        fill(this->clocks, this->clocks + PROFILE_PHASES, 0);
+        fill(this->calls, this->calls + PROFILE_PHASES, 0);
+        this->lap_overhead = ULLONG_MAX;
+        for (int i = 0; i < 1000; i++)
+        {
+            unsigned long long last = profile_clock();
+            unsigned long long now = profile_clock();
+            this->lap_overhead = min(this->lap_overhead, now - last);
+        }
+    }
+
+    // Account the time since `last` to `phase` and start the next lap
+    void lap(int phase, unsigned long long &last)
+    {
+        unsigned long long now = profile_clock();
+        this->clocks[phase] += now - last;
+        this->calls[phase]++;
+        last = now;
+    }
+
+    static void raise(vector<int> &high, size_t i, int value)
+    {
+        if (i >= high.size())
+        { // a device or mutex added during the run
+            high.resize(i + 1, 0);
+        }
+        high[i] = max(high[i], value);
+    }
+
+    void report(const resource_table_t &resources, int ticks) const
+    {
+        static const char *names[] = {"checkpoint", "admit", "devices", "mutexes", "steal", "cpus", "services", "output", "skip"};
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - this->start_time).count();
+        unsigned long long net[PROFILE_PHASES];
+        unsigned long long total = 0;
+        for (int phase = 0; phase < PROFILE_PHASES; phase++)
+        {
+            net[phase] = this->clocks[phase] - min(this->clocks[phase], this->calls[phase] * this->lap_overhead);
+            total += net[phase];
+        }
+        double ns_per_clock = seconds * 1e9 / max(1ULL, profile_clock() - this->start_clock);
+        char line[160];
+        cout << "profile: " << this->iterations << " loop iterations for " << ticks << " ticks, " << seconds << " s, "
+             << this->lap_overhead << " clocks per lap taken off" << endl;
+        snprintf(line, sizeof(line), "%-12s %14s %16s %7s %12s %10s", "phase", "calls", "clocks", "share", "clocks/call", "ms");
+        cout << line << endl;
+        for (int phase = 0; phase < PROFILE_PHASES; phase++)
+        {
+            if (this->calls[phase] == 0)
+            {
+                continue;
+            }
+            snprintf(line, sizeof(line), "%-12s %14lld %16llu %6.1f%% %12.1f %10.1f", names[phase], this->calls[phase], net[phase],
+                     100.0 * net[phase] / max(1ULL, total), (double)net[phase] / this->calls[phase], net[phase] * ns_per_clock / 1e6);
+            cout << line << endl;
+        }
+        cout << "manage_next_service: " << this->manage_calls << " calls, " << this->manage_services << " services" << endl;
+        cout << "high-water marks:";
+        for (size_t cpu = 0; cpu < this->ready_max.size(); cpu++)
+        {
+            cout << " ready cpu" << cpu << " " << this->ready_max[cpu] << ",";
+        }
+        for (size_t device = 0; device < this->device_max.size(); device++)
+        {
+            if (this->device_max[device] > 0)
+            {
+                cout << " device " << resources.device_names[device] << " " << this->device_max[device] << ",";
+            }
+        }
+        for (size_t mutex = 0; mutex < this->mutex_max.size(); mutex++)
+        {
+            if (this->mutex_max[mutex] > 0)
+            {
+                cout << " mutex " << resources.mutex_names[mutex] << " " << this->mutex_max[mutex] << ",";
+            }
+        }
+        cout << " completed in a tick " << this->done_max << endl;
+    }
+};
+
+// The laps of a profiled run chain: each phase ends where the next one starts
+#define PROFILE_START(sim) unsigned long long profile_last = (sim).profile != NULL ? profile_clock() : 0
+#define PROFILE_LAP(sim, phase)                          \
+    if ((sim).profile != NULL)                           \
+    {                                                    \
+        (sim).profile->lap(phase, profile_last);         \
+    }
+#define PROFILE_COUNT(sim, counter)  \
+    if ((sim).profile != NULL)       \
+    {                                \
+        (sim).profile->counter++;    \
+    }
+// Sample queue lengths outside of the phases
+#define PROFILE_QUEUES(sim, policies)            \
+    if ((sim).profile != NULL)                   \
+    {                                            \
+        profile_queues(sim, policies);           \
+        profile_last = profile_clock();          \
+    }
+#else
+#define PROFILE_START(sim)
+#define PROFILE_LAP(sim, phase)
+#define PROFILE_COUNT(sim, counter)
+#define PROFILE_QUEUES(sim, policies)
+#endif
+
+// Whether runs of `policy_t` record an event trace, see traced_t
+template <class policy_t>
+struct is_traced
+{
+    static const bool value = false;
+};
+
+// State of one simulation run, everything but the run queues of the scheduling policy
+struct sim_state_t
+{
+    vector<process_t> processes; // process pool, queues hold indices into it
+    vector<service_t> generated_services; // services of the pool, `service_stride` per process, with a process source
+    const vector<service_t> &services;
+    const resource_table_t &resources;
+    const sched_params_t &params;
+    bool keep_working; // the output needs the working sequences, they are not stored otherwise
+    vector<ring_queue_t> device_queues; // block queue of every I/O device, indexed by device id
+    timing_wheel_t device_wheel;        // tick the I/O of the front of every busy device completes, by device id
+    vector<int> devices_done;           // devices whose I/O completes in the current tick
+    vector<Mutex> mutexes;              // indexed by mutex id
+    vector<ring_queue_t> mutex_queues;  // block queue of every mutex
+    vector<int> released_mutexes;       // mutexes unlocked while processes were waiting for them
+    ring_queue_t processes_done;
+    vector<cpu_state_t> cpus;
+    working_log_t working;             // working intervals of every process in the pool, only logged with keep_working
+    vector<queue_metrics_t> device_metrics; // waits in the block queue of every I/O device, service included
+    vector<queue_metrics_t> mutex_metrics;  // waits in the block queue of every mutex
+    vector<int> drawn_costs;                // cost of every stochastic service in this run, drawn from params.seed
+    unique_ptr<synthetic_source_t> generator; // generator of a synthetic workload
+    process_source_t *source;                 // `generator` or the stream of the workload, set when processes come during the run
+    int service_stride;                       // room for services of every pool entry in `generated_services`
+    vector<int> free_handles;                 // pool entries of completed processes, reused with a process source
+    trace_writer_t *trace;                 // event trace of the run, set for traced policies only
+    lod_builder_t *lod;                    // collects the working intervals of completed processes with --lod
+#ifdef SCHED_PROFILE
+    profiler_t *profile = NULL; // set with --profile
+#endif
+    int total_processes;
+    int cur_tick;
+    int complete_num;
+    int next_arrival_idx; // processes are sorted by arrival, the ones before this index are admitted
+
+    sim_state_t(const workload_t &workload, const sched_params_t &params, bool keep_working)
+        : processes(workload.processes), services(workload.synthetic || workload.stream ? generated_services : workload.services),
+          resources(workload.resources), params(params),
+          keep_working(keep_working), device_queues(workload.resources.device_names.size(), ring_queue_t(1)),
+          mutexes(workload.resources.mutex_names.size()), mutex_queues(workload.resources.mutex_names.size(), ring_queue_t(1)),
+          processes_done(processes.size()), cpus(params.cpus, cpu_state_t(params.levels())),
+          working(keep_working ? processes.size() : 0, params.cpus > 1, params.mem_limit, params.sim_threads > 1 && params.cpus > 1),
+          device_metrics(workload.resources.device_names.size()), mutex_metrics(workload.resources.mutex_names.size()),
+          generator(workload.synthetic ? new synthetic_source_t(workload.spec) : NULL),
+          source(workload.synthetic ? (process_source_t *)generator.get() : workload.stream), service_stride(workload.synthetic ? workload.spec.max_services() : 0),
+          trace(NULL), lod(NULL),
+          total_processes(workload.synthetic ? workload.spec.processes : workload.stream ? INT_MAX : workload.processes.size()),
+          cur_tick(0), complete_num(0), next_arrival_idx(0)
+    {
+        rng_t rng(params.seed);
+        this->drawn_costs.reserve(workload.cost_dists.size());
+        for (size_t i = 0; i < workload.cost_dists.size(); i++)
+        { // a drawn cost takes at least one tick, only a plain 0 gives a 0 tick service
+            this->drawn_costs.push_back(max(workload.cost_dists[i].sample(rng), 1));
+        }
+    }
+
+    // Take the next process of the source into a free pool entry, returns its handle
+    int generate_process()
+    {
+        if (this->source->max_services() > this->service_stride)
+        { // a streamed process with more services than any before: give every entry room for twice as many
+            int stride = max(this->source->max_services(), 2 * this->service_stride);
+            vector<service_t> services(this->processes.size() * stride);
+            for (size_t handle = 0; handle < this->processes.size(); handle++)
+            {
+                copy(this->generated_services.begin() + handle * this->service_stride,
+                     this->generated_services.begin() + (handle + 1) * this->service_stride, services.begin() + handle * stride);
+                this->processes[handle].service_offset = handle * stride;
+            }
+            this->generated_services.swap(services);
+            this->service_stride = stride;
+        }
+        int stride = this->service_stride;
+        int handle;
+        if (!this->free_handles.empty())
+        {
+            handle = this->free_handles.back();
+            this->free_handles.pop_back();
+        }
+        else
+        { // the pool grows up to the largest number of processes in the system at once
+            handle = this->processes.size();
+            this->processes.push_back(process_t());
+            this->generated_services.resize(this->generated_services.size() + stride);
+            if (this->keep_working)
+            {
+                this->working.lists.push_back(working_log_t::list_t());
+            }
+        }
+        process_t &p = this->processes[handle];
+        this->source->next(p, &this->generated_services[handle * stride]);
+        p.service_offset = handle * stride;
+        if (this->source != this->generator.get())
+        { // streamed processes may name devices and mutexes not seen before
+            this->add_resources();
+        }
+        return handle;
+    }
+
+    // Make room for the I/O devices and mutexes the resource table got since the run started
+    void add_resources()
+    {
+        size_t devices = this->resources.device_names.size();
+        size_t mutexes = this->resources.mutex_names.size();
+        this->device_queues.resize(devices, ring_queue_t(1));
+        this->device_metrics.resize(devices);
+        this->mutexes.resize(mutexes);
+        this->mutex_queues.resize(mutexes, ring_queue_t(1));
+        this->mutex_metrics.resize(mutexes);
+    }
+
+    // Everything but the run queues, which the policies save
+    void save(snapshot_t &snap) const
+    {
+        snap.put(this->cur_tick);
+        snap.put(this->complete_num);
+        snap.put(this->next_arrival_idx);
+        snap.put(this->processes.size());
+        for (size_t i = 0; i < this->processes.size(); i++)
+        {
+            const process_t &p = this->processes[i];
+            snap.put(p.process_id);
+            snap.put(p.arrival_time);
+            snap.put(p.service_offset);
+            snap.put(p.service_num);
+            snap.put(p.cur_service_idx);
+            snap.put(this->service_progress(i));
+            snap.put(p.priority);
+            snap.put(p.cpu);
+            snap.put(p.first_dispatch_tick);
+            snap.put(p.queued_tick);
+            snap.put(p.vruntime);
+            snap.put(this->keep_working ? this->working.lists[i].intervals : 0);
+            if (this->keep_working)
+            {
+                this->working.for_each(i, [&snap](int start_tick, int end_tick, int cpu)
+                                       {
+                                           snap.put(start_tick);
+                                           snap.put(end_tick);
+                                           snap.put(cpu);
+                                       });
+            }
+        }
+        snap.put(this->generated_services.size());
+        for (size_t i = 0; i < this->generated_services.size(); i++)
+        {
+            snap.put(this->generated_services[i].type);
+            snap.put(this->generated_services[i].time_cost);
+            snap.put(this->generated_services[i].resource);
+        }
+        for (size_t device = 0; device < this->device_queues.size(); device++)
+        {
+            snap.put_queue(this->device_queues[device]);
+            this->device_metrics[device].save(snap);
+        }
+        vector<int> busy_devices; // ascending
+        for (size_t device = 0; device < this->device_queues.size(); device++)
+        {
+            if (!this->device_queues[device].empty())
+            {
+                busy_devices.push_back(device);
+            }
+        }
+        snap.put_ints(busy_devices);
+        for (size_t mutex = 0; mutex < this->mutexes.size(); mutex++)
+        {
+            snap.put(this->mutexes[mutex].status_lock);
+            snap.put_queue(this->mutex_queues[mutex]);
+            this->mutex_metrics[mutex].save(snap);
+        }
+        snap.put_ints(this->released_mutexes);
+        snap.put_queue(this->processes_done);
+        for (size_t cpu = 0; cpu < this->cpus.size(); cpu++)
+        {
+            const cpu_state_t &state = this->cpus[cpu];
+            snap.put(state.dispatched_tick);
+            snap.put(state.prev_process_id);
+            snap.put(state.running);
+            snap.put(state.service_done);
+            snap.put(state.busy_ticks);
+            for (size_t level = 0; level < state.ready_queues.size(); level++)
+            {
+                state.ready_queues[level].save(snap);
+            }
+        }
+        if (this->generator)
+        { // a stream is never saved, its input cannot be read again
+            snap.put(this->generator->rng.state);
+            snap.put(this->generator->next_id);
+            snap.put(this->generator->next_arrival_tick);
+            snap.put_ints(this->generator->mutex_names);
+            snap.put_ints(this->free_handles);
+        }
+    }
+    // Restore what save() wrote for the same workload, fails if the snapshot does not fit it
+    bool restore(snapshot_t &snap)
+    {
+        this->cur_tick = snap.get_int(0, INT_MAX);
+        this->complete_num = snap.get_int(0, this->total_processes);
+        this->next_arrival_idx = snap.get_int(0, this->processes.size());
+        int process_num = snap.get_int(0, this->source ? INT_MAX : this->processes.size());
+        if (snap.failed || (!this->source && process_num != (int)this->processes.size()))
+        {
+            return false;
+        }
+        this->processes.resize(process_num);
+        if (this->keep_working)
+        {
+            this->working.lists.resize(process_num);
+        }
+        for (int i = 0; i < process_num && !snap.failed; i++)
+        {
+            process_t &p = this->processes[i];
+            p.process_id = snap.get();
+            p.arrival_time = snap.get();
+            p.service_offset = snap.get_int(0, INT_MAX);
+            p.service_num = snap.get_int(0, INT_MAX);
+            p.cur_service_idx = snap.get_int(0, p.service_num);
+            p.cur_service_tick = snap.get();
+            p.priority = snap.get_int(0, this->params.levels() - 1);
+            p.cpu = snap.get_int(0, this->cpus.size() - 1);
+            p.first_dispatch_tick = snap.get();
+            p.queued_tick = snap.get();
+            p.vruntime = snap.get();
+            for (int n = snap.get_int(0, this->keep_working ? INT_MAX : 0); n > 0 && !snap.failed; n--)
+            {
+                int start_tick = snap.get_int(INT_MIN, INT_MAX);
+                int end_tick = snap.get_int(INT_MIN, INT_MAX);
+                this->working.append(i, start_tick, end_tick, snap.get_int(0, this->cpus.size() - 1));
+            }
+        }
+        this->generated_services.resize(snap.get_int(0, this->source ? INT_MAX : 0));
+        for (size_t i = 0; i < this->generated_services.size() && !snap.failed; i++)
+        {
+            this->generated_services[i].type = snap.get_int(SERVICE_C, SERVICE_U);
+            this->generated_services[i].time_cost = snap.get();
+            this->generated_services[i].resource = snap.get_int(0, max(this->device_queues.size(), this->mutexes.size()) - 1);
+        }
+        for (size_t i = 0; i < this->processes.size(); i++)
+        { // every service a process refers to is in the arena
+            const process_t &p = this->processes[i];
+            if ((long long)p.service_offset + p.service_num > (long long)this->services.size())
+            {
+                return false;
+            }
+        }
+        for (size_t device = 0; device < this->device_queues.size(); device++)
+        {
+            snap.get_queue(this->device_queues[device], process_num);
+            this->device_metrics[device].restore(snap);
+        }
+        vector<int> busy_devices; // follows from the queues
+        snap.get_ints(busy_devices, 0, this->device_queues.size() - 1);
+        this->device_wheel.clear(this->cur_tick);
+        for (size_t device = 0; device < this->device_queues.size(); device++)
+        {
+            if (!this->device_queues[device].empty())
+            { // the I/O of the front completes as soon as it got its time, at the earliest in the current tick
+                const process_t &p = this->processes[this->device_queues[device].front()];
+                if (p.cur_service_idx >= p.service_num)
+                {
+                    return false;
+                }
+                this->device_wheel.add(device, due_tick(this->cur_tick, max(this->cost(p.cur_service(this->services)) - p.cur_service_tick, 0)));
+            }
+        }
+        for (size_t mutex = 0; mutex < this->mutexes.size(); mutex++)
+        {
+            this->mutexes[mutex].status_lock = snap.get_int(0, 1);
+            snap.get_queue(this->mutex_queues[mutex], process_num);
+            this->mutex_metrics[mutex].restore(snap);
+        }
+        snap.get_ints(this->released_mutexes, 0, (long long)this->mutexes.size() - 1);
+        snap.get_queue(this->processes_done, process_num);
+        for (size_t cpu = 0; cpu < this->cpus.size(); cpu++)
+        {
+            cpu_state_t &state = this->cpus[cpu];
+            state.dispatched_tick = snap.get();
+            state.prev_process_id = snap.get();
+            state.running = snap.get_int(-1, process_num - 1);
+            state.service_done = snap.get_int(0, 1);
+            state.busy_ticks = snap.get();
+            for (size_t level = 0; level < state.ready_queues.size(); level++)
+            {
+                state.ready_queues[level].restore(snap);
+            }
+        }
+        if (this->generator)
+        {
+            this->generator->rng.state = snap.get();
+            this->generator->next_id = snap.get_int(0, this->total_processes);
+            this->generator->next_arrival_tick = snap.get();
+            snap.get_ints(this->generator->mutex_names, -1, this->generator->spec.mutexes - 1);
+            snap.get_ints(this->free_handles, 0, process_num - 1);
+        }
+        return !snap.failed;
+    }
+
+    // Initial capacity of a run queue, the processes are spread over the CPUs
+    int queue_capacity() const
+    {
+        return this->processes.size() / this->cpus.size() + 1;
+    }
+
+    const service_t &cur_service(int handle) const
+    {
+        return this->processes[handle].cur_service(this->services);
+    }
+    // Tick `ticks` after `start`, at most MAX_TICK + 1: a run that gets there stops before it overflows
+    static int due_tick(int start, int ticks)
+    {
+        return (int)min((long long)start + ticks, (long long)MAX_TICK + 1);
+    }
+    // Ticks a C, K or D service takes in this run
+    int cost(const service_t &service) const
+    {
+        return service.draw < 0 ? service.time_cost : this->drawn_costs[service.draw];
+    }
+    // Ticks spent on the current service of a process. The I/O of the front of a device queue is not counted
+    // tick by tick, it follows from the tick it completes
+    int service_progress(int handle) const
+    {
+        const process_t &p = this->processes[handle];
+        if (p.cur_service_idx < p.service_num)
+        {
+            const service_t &service = p.cur_service(this->services);
+            if ((service.type == SERVICE_D || service.type == SERVICE_K) && !this->device_queues[service.resource].empty() &&
+                this->device_queues[service.resource].front() == handle)
+            {
+                return this->cost(service) - (this->device_wheel.due[service.resource] - this->cur_tick);
+            }
+        }
+        return p.cur_service_tick;
+    }
+    // Ticks left of the current service of a process: the length of its next CPU burst when it is ready
+    int remaining_ticks(int handle) const
+    {
+        return this->cost(this->cur_service(handle)) - this->processes[handle].cur_service_tick;
+    }
+    // Log that `handle` ran on `cpu` from `start_tick` to `end_tick`
+    TICK_INLINE void log_working(int handle, int start_tick, int end_tick, int cpu)
+    {
+        if (!this->keep_working)
+        {
+            return;
+        }
+        this->working.append(handle, start_tick, end_tick, cpu);
+    }
+    // Account the wait of `handle` in the run queue of `cpu`, which dispatches it in the current tick
+    TICK_INLINE void log_dispatch(int handle, int cpu)
+    {
+        process_t &p = this->processes[handle];
+        this->cpus[cpu].ready_queues[p.priority].add(this->cur_tick - p.queued_tick);
+        if (p.first_dispatch_tick < 0)
+        {
+            p.first_dispatch_tick = this->cur_tick;
+        }
+    }
+    // Record `event` of `handle` in the buffer of `cpu`, at the current tick unless `tick` is given. Compiled
+    // in for traced policies only, `event` is a constant so only the bookkeeping it needs is compiled in
+    template <class policy_t, int event>
+    TICK_INLINE void trace_event(int cpu, int handle, int resource, int tick = -1)
+    {
+        if (is_traced<policy_t>::value)
+        {
+            int process_id = this->processes[handle].process_id;
+            tick = tick < 0 ? this->cur_tick : tick;
+            int &traced_process_id = this->cpus[cpu].traced_process_id;
+            if (event == TRACE_DISPATCH)
+            {
+                if (traced_process_id >= 0 && traced_process_id != process_id)
+                { // the process on the CPU was displaced without a clock interrupt, by a higher FB level
+                    this->trace->add(cpu, tick - 1, traced_process_id, cpu, TRACE_PREEMPT);
+                }
+                traced_process_id = process_id;
+            }
+            else if (event == TRACE_PREEMPT || event == TRACE_BLOCK_DEVICE || event == TRACE_BLOCK_MUTEX || event == TRACE_COMPLETE)
+            {
+                traced_process_id = -1;
+            }
+            this->trace->add(cpu, tick, process_id, resource, event);
+        }
+    }
+    // Record the preemption of `handle`, which last ran at `tick`, and its demotion if it left FB level `level`
+    template <class policy_t>
+    TICK_INLINE void trace_preempt(int cpu, int handle, int level, int tick)
+    {
+        if (is_traced<policy_t>::value)
+        {
+            this->trace_event<policy_t, TRACE_PREEMPT>(cpu, handle, cpu, tick);
+            if (this->processes[handle].priority != level)
+            {
+                this->trace_event<policy_t, TRACE_DEMOTE>(cpu, handle, this->processes[handle].priority, tick);
+            }
+        }
+    }
+    // Called at the end of the current tick: the I/O of a process that finds the device idle starts next tick
+    void block_on_device(int device, int handle)
+    {
+        if (this->device_queues[device].empty())
+        { // the device gets busy
+            this->device_wheel.add(device, due_tick(this->cur_tick + 1, this->cost(this->cur_service(handle))));
+        }
+        this->device_queues[device].push_back(handle);
+#ifdef SCHED_PROFILE
+        if (this->profile != NULL)
+        {
+            profiler_t::raise(this->profile->device_max, device, this->device_queues[device].size());
+        }
+#endif
+    }
+};
+
+// FNV-1a hash of everything a run reads from its workload: a snapshot only fits the workload it was taken on
+unsigned long long workload_fingerprint(const workload_t &workload);
+
+// Settings of the run a snapshot was taken from, at the start of the snapshot
+struct snapshot_header_t
+{
+    string algorithm;
+    unsigned long long fingerprint;
+    int format;              // output_format_t
+    string output_path;
+    long long output_offset; // bytes of the output log written before the snapshot
+    int cpus;
+    int levels;
+    int quantum;
+    vector<int> fb_quanta;
+    int fb_aging;
+    int fb_boost;
+    int min_granularity;
+    int steal;
+    unsigned long long seed;
+    snapshot_header_t()
+        : fingerprint(0), format(OUTPUT_TEXT), output_offset(0), cpus(1), levels(FB_LEVELS), quantum(DEFAULT_QUANTUM), fb_aging(0), fb_boost(0),
+          min_granularity(DEFAULT_QUANTUM), steal(STEAL_BUSIEST), seed(1) {}
+    snapshot_header_t(const string &algorithm, const workload_t &workload, const sched_params_t &params, const output_writer_t &output)
+        : algorithm(algorithm), fingerprint(workload_fingerprint(workload)), format(output.format), output_path(output.path),
+          output_offset(0), cpus(params.cpus), levels(params.levels()), quantum(params.quantum), fb_quanta(params.fb_quanta),
+          fb_aging(params.fb_aging), fb_boost(params.fb_boost), min_granularity(params.min_granularity), steal(params.steal),
+          seed(params.seed) {}
+
+    void save(snapshot_t &snap) const
+    {
+        snap.put_string(this->algorithm);
+        snap.put(this->fingerprint);
+        snap.put(this->format);
+        snap.put_string(this->output_path);
+        snap.put(this->output_offset);
+        snap.put(this->cpus);
+        snap.put(this->levels);
+        snap.put(this->quantum);
+        snap.put_ints(this->fb_quanta);
+        snap.put(this->fb_aging);
+        snap.put(this->fb_boost);
+        snap.put(this->min_granularity);
+        snap.put(this->steal);
+        snap.put(this->seed);
+    }
+    bool restore(snapshot_t &snap)
+    {
+        this->algorithm = snap.get_string();
+        this->fingerprint = snap.get();
+        this->format = snap.get();
+        this->output_path = snap.get_string();
+        this->output_offset = snap.get();
+        this->cpus = snap.get();
+        this->levels = snap.get();
+        this->quantum = snap.get();
+        snap.get_ints(this->fb_quanta, 1, INT_MAX);
+        this->fb_aging = snap.get();
+        this->fb_boost = snap.get();
+        this->min_granularity = snap.get();
+        this->steal = snap.get();
+        this->seed = snap.get();
+        return !snap.failed;
+    }
+    // Whether a run of `algorithm` with `params` can continue from the snapshot. A fork may change the
+    // time quanta, FB aging and boosts, the CFS granularity and the steal policy, a resumed run has to keep
+    // every setting. The seed only matters to a workload with stochastic service costs, which it draws
+    bool fits(const string &algorithm, const workload_t &workload, const sched_params_t &params, int format, bool fork) const
+    {
+        const char *mismatch = NULL;
+        if (algorithm != this->algorithm)
+        {
+            mismatch = "algorithm";
+        }
+        else if (format != this->format)
+        {
+            mismatch = "output format";
+        }
+        else if (params.cpus != this->cpus || params.levels() != this->levels)
+        {
+            mismatch = "number of CPUs or FB levels";
+        }
+        else if (!fork && (params.quantum != this->quantum || params.fb_quanta != this->fb_quanta || params.fb_aging != this->fb_aging ||
+                           params.fb_boost != this->fb_boost || params.min_granularity != this->min_granularity || params.steal != this->steal))
+        {
+            mismatch = "time quanta, FB aging or boosts, CFS granularity or steal policy (--fork-at can change them)";
+        }
+        else if (workload_fingerprint(workload) != this->fingerprint)
+        {
+            mismatch = "workload";
+        }
+        else if (!workload.cost_dists.empty() && params.seed != this->seed)
+        {
+            mismatch = "seed";
+        }
+        if (mismatch != NULL)
+        {
+            cerr << "The snapshot does not fit this run: different " << mismatch << endl;
+        }
+        return mismatch == NULL;
+    }
+};
+
+// Copy the metrics kept per CPU and per queue during the run into `summary`
+void collect_metrics(const sim_state_t &sim, run_summary_t &summary);
+
+// One simulation run: its state and summary, with the run queues and the tick loop of the policy behind
+// the virtual calls. These are made once per run_until(), never per tick
+struct sim_run_t
+{
+    sim_state_t sim;
+    run_summary_t summary;
+    sim_run_t(const workload_t &workload, const sched_params_t &params, bool keep_working) : sim(workload, params, keep_working) {}
+    virtual ~sim_run_t() {}
+
+    // Before the first tick: restore `resume` if not NULL, open the trace. Fails with `summary.failed` set
+    virtual bool start(snapshot_t *resume) = 0;
+    // Simulate the ticks before `limit`, returns false as soon as no process can make progress any more,
+    // `sim.cur_tick` is then the tick after the last one simulated
+    virtual bool run_until(int limit) = 0;
+    // After the last tick: write the trace, the LOD pyramid and the metrics report, fill in `summary`
+    virtual void finish() = 0;
+    virtual int load(int cpu) const = 0; // processes in the run queue of `cpu`
+};
+
+bool is_algorithm(const string &algorithm);
+
+// Create the run of one scheduling algorithm (FCFS, RR, FB, SPN, SRT, HRRN or CFS) over `workload`. The policy
+// is traced only with a trace path, so untraced runs carry no tracing code in their tick loop
+sim_run_t *new_run(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output);
+
+// Run one scheduling algorithm (FCFS, RR, FB, SPN, SRT, HRRN or CFS) over a parsed workload
+// `resume` is a snapshot read up to its state, the run continues from there
+run_summary_t run_algorithm(const string &algorithm, const workload_t &workload, const sched_params_t &params, output_writer_t &output,
+                            snapshot_t *resume = NULL);
+
+// Parse a list of positive integers separated by `delim`
+bool parse_int_list(const string &s, vector<int> &values, const string &delim);
+
+// Parse the name of a steal_policy_t into `values`
+bool parse_steal_policy(const string &name, vector<int> &values);
+
+// Parse a service mix "CPU:IO:MUTEX" of non-negative weights, at least one of them positive
+bool parse_mix(const string &text, synthetic_spec_t &spec);
+
+// Parse "n=N,mix=CPU:IO:MUTEX,arrival=DIST,burst=DIST,io=DIST,mutexes=N,sections=single|nested,seed=N",
+// every key is optional
+bool parse_synthetic_spec(const string &text, synthetic_spec_t &spec);
+
+#define SYNTHETIC_PREFIX "synthetic:"
+
+// Load the process file at `path`, or set up the synthetic workload of a path "synthetic:<spec>"
+bool load_workload(const char *path, workload_t &workload);
+
+#endif